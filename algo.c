@@ -36,6 +36,14 @@ void *panda_algorithm_data(
 	return &algo->end;
 }
 
+const overlap_table *algorithm_overlap_table(
+	PandaAlgorithm algorithm) {
+	if (algorithm->clazz->overlap_table == NULL) {
+		return NULL;
+	}
+	return algorithm->clazz->overlap_table(&algorithm->end);
+}
+
 PandaAlgorithmClass panda_algorithm_class(
 	PandaAlgorithm algo) {
 	return algo->clazz;
@@ -20,6 +20,7 @@
 #        define ALGO_H
 #        include "config.h"
 #        include "pandaseq.h"
+#        include "kernel.h"
 #        include "misc.h"
 #        ifdef HAVE_PTHREAD
 #                include <pthread.h>
@@ -34,4 +35,8 @@ struct panda_algorithm {
 	void *end;
 };
 
+/* Get the table a built-in algorithm scores overlaps with, or NULL if it does not use one, so the assembler can score its already separated reads directly. */
+const overlap_table *algorithm_overlap_table(
+	PandaAlgorithm algorithm);
+
 #endif
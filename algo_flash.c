@@ -24,9 +24,30 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "pandaseq.h"
+#include "packed.h"
 #include "prob.h"
 #include "table.h"
 
+static double overlap_counts(
+	void *data,
+	size_t forward_length,
+	size_t reverse_length,
+	size_t overlap,
+	size_t matches,
+	size_t mismatches,
+	size_t unknowns) {
+	/* Uncalled bases count against the overlap. */
+	size_t real_mismatches = mismatches + unknowns;
+	size_t real_overlap = matches + mismatches + unknowns;
+
+	(void) data;
+	(void) forward_length;
+	(void) reverse_length;
+	(void) overlap;
+
+	return real_overlap == 0 ? -2 : log(real_mismatches / real_overlap);
+}
+
 static double overlap_probability(
 	void *data,
 	const panda_qual *forward,
@@ -34,29 +55,12 @@ static double overlap_probability(
 	const panda_qual *reverse,
 	size_t reverse_length,
 	size_t overlap) {
-	int sum_quality = 0;
-	size_t mismatches = 0;
-	size_t real_overlap = 0;
-	size_t i;
-
-	(void) data;
-
-	for (i = 0; i < overlap; i++) {
-		int findex = forward_length + i - overlap;
-		int rindex = reverse_length - i - 1;
-		if (findex < 0 || rindex < 0 || (size_t) findex >= forward_length || (size_t) rindex >= reverse_length)
-			continue;
-		panda_nt f = forward[findex].nt;
-		panda_nt r = reverse[rindex].nt;
-		if (PANDA_NT_IS_N(f) || PANDA_NT_IS_N(r) || (f & r) == 0) {
-			char min_quality = forward[findex].qual < reverse[rindex].qual ? forward[findex].qual : reverse[rindex].qual;
-			mismatches++;
-			sum_quality += min_quality;
-		}
-		real_overlap++;
-	}
+	size_t matches;
+	size_t mismatches;
+	size_t unknowns;
 
-	return real_overlap == 0 ? -2 : log(mismatches / real_overlap);
+	count_overlap(forward, forward_length, reverse, reverse_length, overlap, &matches, &mismatches, &unknowns);
+	return overlap_counts(data, forward_length, reverse_length, overlap, matches, mismatches, unknowns);
 }
 
 static double match_probability(
@@ -96,6 +100,8 @@ const struct panda_algorithm_class panda_algorithm_flash_class = {
 	.overlap_probability = (PandaComputeOverlap) overlap_probability,
 	.match_probability = (PandaComputeMatch) match_probability,
 	.prob_unpaired = qual_nn_simple_bayesian,
+	.overlap_counts = (PandaComputeOverlapCounts) overlap_counts,
+	.match_probability_fixed = true,
 };
 
 PandaAlgorithm panda_algorithm_flash_new(
@@ -22,10 +22,12 @@
 #include <stdlib.h>
 #include "pandaseq.h"
 #include "algo.h"
+#include "kernel.h"
 #include "prob.h"
 #include "table.h"
 
 struct pear {
+	overlap_table table;
 	double random_base;
 };
 
@@ -36,26 +38,20 @@ static double overlap_probability(
 	const panda_qual *reverse,
 	size_t reverse_length,
 	size_t overlap) {
-	double probability = 0;
-	size_t i;
-
-	for (i = 0; i < overlap; i++) {
-		int findex = forward_length + i - overlap;
-		int rindex = reverse_length - i - 1;
-		if (findex < 0 || rindex < 0 || (size_t) findex >= forward_length || (size_t) rindex >= reverse_length)
-			continue;
-		panda_nt f = forward[findex].nt;
-		panda_nt r = reverse[rindex].nt;
-		if (PANDA_NT_IS_N(f) || PANDA_NT_IS_N(r)) {
-			probability -= data->random_base;
-		} else if ((f & r) != 0) {
-			probability += qual_match_pear[PHREDCLAMP(forward[findex].qual)][PHREDCLAMP(forward[rindex].qual)];
-		} else {
-			probability += qual_mismatch_pear[PHREDCLAMP(forward[findex].qual)][PHREDCLAMP(forward[rindex].qual)];
-		}
-	}
+	return overlap_table_probability(&data->table, forward, forward_length, reverse, reverse_length, overlap);
+}
 
-	return probability;
+static ptrdiff_t overlap_probability_batch(
+	struct pear *data,
+	const panda_qual *forward,
+	size_t forward_length,
+	const panda_qual *reverse,
+	size_t reverse_length,
+	const size_t *overlaps,
+	size_t overlaps_length,
+	double *best_probability,
+	double *probabilities) {
+	return overlap_table_best(&data->table, forward, forward_length, reverse, reverse_length, overlaps, overlaps_length, best_probability, probabilities);
 }
 
 static double match_probability(
@@ -67,6 +63,11 @@ static double match_probability(
 	return (match ? qual_match_pear : qual_mismatch_pear)[PHREDCLAMP(a)][PHREDCLAMP(b)];
 }
 
+static const overlap_table *get_overlap_table(
+	struct pear *data) {
+	return &data->table;
+}
+
 static PandaAlgorithm from_string(
 	const char *argument) {
 	PandaAlgorithm algo;
@@ -98,11 +99,16 @@ const struct panda_algorithm_class panda_algorithm_pear_class = {
 	.overlap_probability = (PandaComputeOverlap) overlap_probability,
 	.match_probability = (PandaComputeMatch) match_probability,
 	.prob_unpaired = qual_nn_simple_bayesian,
+	.overlap_probability_batch = (PandaComputeOverlapBatch) overlap_probability_batch,
+	.match_probability_fixed = true,
+	.overlap_table = (PandaGetOverlapTable) get_overlap_table,
 };
 
 PandaAlgorithm panda_algorithm_pear_new(
 	void) {
 	PandaAlgorithm algo = panda_algorithm_new(&panda_algorithm_pear_class);
+	struct pear *data = panda_algorithm_data(algo);
+	overlap_table_init(&data->table, qual_match_pear, qual_mismatch_pear, 0, true, 0);
 	panda_algorithm_pear_set_random_base_log_p(algo, log(0.25));
 	return algo;
 }
@@ -111,7 +117,10 @@ void panda_algorithm_pear_set_random_base_log_p(
 	PandaAlgorithm algorithm,
 	double log_p) {
 	if (panda_algorithm_is_a(algorithm, &panda_algorithm_pear_class)) {
-		((struct pear *) panda_algorithm_data(algorithm))->random_base = log_p;
+		struct pear *data = panda_algorithm_data(algorithm);
+		data->random_base = log_p;
+		/* Any overlap with an N is treated as a random match. */
+		overlap_table_set_unknown(&data->table, -log_p);
 	}
 }
 
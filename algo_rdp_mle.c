@@ -23,9 +23,14 @@
 #include <string.h>
 #include "pandaseq.h"
 #include "algo.h"
+#include "kernel.h"
 #include "prob.h"
 #include "table.h"
 
+struct rdp_mle {
+	overlap_table table;
+};
+
 static double match_probability(
 	void *data,
 	bool match,
@@ -41,36 +46,32 @@ static double match_probability(
 }
 
 static double overlap_probability(
-	void *data,
+	struct rdp_mle *data,
 	const panda_qual *forward,
 	size_t forward_length,
 	const panda_qual *reverse,
 	size_t reverse_length,
 	size_t overlap) {
+	/* when two bases match, the assumption that the forward and reverse bases are from independent observations doesn't work with the MiSeq mock community data we tested. Instead, the higher score of the two raw base q scores is close to the predicated error rate */
+	return overlap_table_probability(&data->table, forward, forward_length, reverse, reverse_length, overlap);
+}
 
-	double probability = 0;
-	size_t i;
-
-	(void) data;
-	for (i = 0; i < overlap; i++) {
-		int findex = forward_length + i - overlap;
-		int rindex = reverse_length - i - 1;
-		if (findex < 0 || rindex < 0 || (size_t) findex > forward_length || (size_t) rindex > reverse_length)
-			continue;
-		panda_nt f = forward[findex].nt;
-		panda_nt r = reverse[rindex].nt;
-		char fqual = PHREDCLAMP(forward[findex].qual);
-		char rqual = PHREDCLAMP(reverse[rindex].qual);
-		bool ismatch = ((f & r) != 0);
+static ptrdiff_t overlap_probability_batch(
+	struct rdp_mle *data,
+	const panda_qual *forward,
+	size_t forward_length,
+	const panda_qual *reverse,
+	size_t reverse_length,
+	const size_t *overlaps,
+	size_t overlaps_length,
+	double *best_probability,
+	double *probabilities) {
+	return overlap_table_best(&data->table, forward, forward_length, reverse, reverse_length, overlaps, overlaps_length, best_probability, probabilities);
+}
 
-		/* when two bases match, the assumption that the forward and reverse bases are from independent observations doesn't work with the MiSeq mock community data we tested. Instead, the higher score of the two raw base q scores is close to the predicated error rate */
-		if (ismatch) {
-			probability += qual_match_simple_bayesian[(int) fqual][(int) rqual] - qual_nn_simple_bayesian;
-		} else {
-			probability += qual_mismatch_rdp_mle[(int) fqual][(int) rqual] - qual_nn_simple_bayesian;
-		}
-	}
-	return probability;
+static const overlap_table *get_overlap_table(
+	struct rdp_mle *data) {
+	return &data->table;
 }
 
 static PandaAlgorithm from_string(
@@ -82,17 +83,22 @@ static PandaAlgorithm from_string(
 }
 
 const struct panda_algorithm_class panda_algorithm_rdp_mle_class = {
-	.data_size = 0,
+	.data_size = sizeof(struct rdp_mle),
 	.name = "rdp_mle",
 	.create = from_string,
 	.data_destroy = NULL,
 	.overlap_probability = (PandaComputeOverlap) overlap_probability,
 	.match_probability = (PandaComputeMatch) match_probability,
 	.prob_unpaired = qual_nn_simple_bayesian,
+	.overlap_probability_batch = (PandaComputeOverlapBatch) overlap_probability_batch,
+	.match_probability_fixed = true,
+	.overlap_table = (PandaGetOverlapTable) get_overlap_table,
 };
 
 PandaAlgorithm panda_algorithm_rdp_mle_new(
 	void) {
 	PandaAlgorithm algo = panda_algorithm_new(&panda_algorithm_rdp_mle_class);
+	struct rdp_mle *data = panda_algorithm_data(algo);
+	overlap_table_init(&data->table, qual_match_simple_bayesian, qual_mismatch_rdp_mle, qual_nn_simple_bayesian, false, 0);
 	return algo;
 }
@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "pandaseq.h"
+#include "packed.h"
 #include "prob.h"
 #include "table.h"
 
@@ -30,34 +31,14 @@ struct simple_bayes {
 	double pmismatch;
 };
 
-static double overlap_probability(
+static double overlap_counts(
 	struct simple_bayes *data,
-	const panda_qual *forward,
 	size_t forward_length,
-	const panda_qual *reverse,
 	size_t reverse_length,
-	size_t overlap) {
-	size_t matches = 0;
-	size_t mismatches = 0;
-	size_t unknowns = 0;
-	size_t i;
-
-	for (i = 0; i < overlap; i++) {
-		int findex = forward_length + i - overlap;
-		int rindex = reverse_length - i - 1;
-		if (findex < 0 || rindex < 0 || (size_t) findex >= forward_length || (size_t) rindex >= reverse_length)
-			continue;
-		panda_nt f = forward[findex].nt;
-		panda_nt r = reverse[rindex].nt;
-		if (PANDA_NT_IS_N(f) || PANDA_NT_IS_N(r)) {
-			unknowns++;
-		} else if ((f & r) != 0) {
-			matches++;
-		} else {
-			mismatches++;
-		}
-	}
-
+	size_t overlap,
+	size_t matches,
+	size_t mismatches,
+	size_t unknowns) {
 	if (overlap >= forward_length && overlap >= reverse_length) {
 		return (qual_nn_simple_bayesian * unknowns + matches * data->pmatch + mismatches * data->pmismatch);
 	} else {
@@ -65,6 +46,21 @@ static double overlap_probability(
 	}
 }
 
+static double overlap_probability(
+	struct simple_bayes *data,
+	const panda_qual *forward,
+	size_t forward_length,
+	const panda_qual *reverse,
+	size_t reverse_length,
+	size_t overlap) {
+	size_t matches;
+	size_t mismatches;
+	size_t unknowns;
+
+	count_overlap(forward, forward_length, reverse, reverse_length, overlap, &matches, &mismatches, &unknowns);
+	return overlap_counts(data, forward_length, reverse_length, overlap, matches, mismatches, unknowns);
+}
+
 static double match_probability(
 	struct simple_bayes *data,
 	bool match,
@@ -105,6 +101,8 @@ const struct panda_algorithm_class panda_algorithm_simple_bayes_class = {
 	.overlap_probability = (PandaComputeOverlap) overlap_probability,
 	.match_probability = (PandaComputeMatch) match_probability,
 	.prob_unpaired = qual_nn_simple_bayesian,
+	.overlap_counts = (PandaComputeOverlapCounts) overlap_counts,
+	.match_probability_fixed = true,
 };
 
 PandaAlgorithm panda_algorithm_simple_bayes_new(
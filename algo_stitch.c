@@ -22,9 +22,27 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "pandaseq.h"
+#include "packed.h"
 #include "prob.h"
 #include "table.h"
 
+static double overlap_counts(
+	void *data,
+	size_t forward_length,
+	size_t reverse_length,
+	size_t overlap,
+	size_t matches,
+	size_t mismatches,
+	size_t unknowns) {
+	size_t score = matches - mismatches;
+
+	(void) data;
+	(void) overlap;
+	(void) unknowns;
+
+	return log(score / (double) (forward_length + reverse_length));
+}
+
 static double overlap_probability(
 	void *data,
 	const panda_qual *forward,
@@ -32,28 +50,12 @@ static double overlap_probability(
 	const panda_qual *reverse,
 	size_t reverse_length,
 	size_t overlap) {
-	size_t score = 0;
-	size_t i;
-
-	(void) data;
+	size_t matches;
+	size_t mismatches;
+	size_t unknowns;
 
-	for (i = 0; i < overlap; i++) {
-		int findex = forward_length + i - overlap;
-		int rindex = reverse_length - i - 1;
-		if (findex < 0 || rindex < 0 || (size_t) findex >= forward_length || (size_t) rindex >= reverse_length)
-			continue;
-		panda_nt f = forward[findex].nt;
-		panda_nt r = reverse[rindex].nt;
-		if (PANDA_NT_IS_N(f) || PANDA_NT_IS_N(r)) {
-			score += 0;
-		} else if ((f & r) != 0) {
-			score += 1;
-		} else {
-			score -= 1;
-		}
-	}
-
-	return log(score / (double) (forward_length + reverse_length));
+	count_overlap(forward, forward_length, reverse, reverse_length, overlap, &matches, &mismatches, &unknowns);
+	return overlap_counts(data, forward_length, reverse_length, overlap, matches, mismatches, unknowns);
 }
 
 static double match_probability(
@@ -84,6 +86,8 @@ const struct panda_algorithm_class panda_algorithm_stitch_class = {
 	.overlap_probability = (PandaComputeOverlap) overlap_probability,
 	.match_probability = (PandaComputeMatch) match_probability,
 	.prob_unpaired = qual_nn_simple_bayesian,
+	.overlap_counts = (PandaComputeOverlapCounts) overlap_counts,
+	.match_probability_fixed = true,
 };
 
 PandaAlgorithm panda_algorithm_stitch_new(
@@ -278,6 +278,7 @@ struct data {
 	bool help;
 	size_t num_kmers;
 	bool version;
+	const char *demux_filename;
 	PandaWriter writer_err;
 	PandaWriter writer_out;
 #ifdef HAVE_PTHREAD
@@ -291,6 +292,7 @@ static const panda_tweak_general logging = {.flag = 'd',.optional = true,.takes_
 static const panda_tweak_general kmers = {.flag = 'k',.optional = true,.takes_argument = "kmers",.help = "The number of k-mers in the table." };
 static const panda_tweak_general fastq = {.flag = 'F',.optional = true,.takes_argument = NULL,.help = "Output FASTQ instead of FASTA." };
 static const panda_tweak_general logfile = {.flag = 'g',.optional = true,.takes_argument = "log.txt",.help = "Output log to a text file." };
+static const panda_tweak_general demux = {.flag = 'M',.optional = true,.takes_argument = "samples.txt",.help = "Write the sequences for each sample to a separate file. Each line of the file is a tag followed by the file name for that tag's sequences. If a file name ends in .bz2, it will be BZip2-compressed. Sequences with any other tag are written to the normal output." };
 static const panda_tweak_general logfile_bz = {.flag = 'G',.optional = true,.takes_argument = "log.txt.bz2",.help = "Output log to a BZip2-compressed text file." };
 
 #		ifdef HAVE_PTHREAD
@@ -308,6 +310,7 @@ static const panda_tweak_general *common_args[] = {
 	&logfile,
 	&logfile_bz,
 	&logging,
+	&demux,
 	&outputfile,
 	&outputfile_bz,
 #		ifdef HAVE_PTHREAD
@@ -374,6 +377,9 @@ static bool common_tweak_general(
 	case 'h':
 		data->help = true;
 		return true;
+	case 'M':
+		data->demux_filename = argument;
+		return true;
 	case 'k':
 		errno = 0;
 		value = strtol(argument, NULL, 10);
@@ -410,7 +416,78 @@ static bool common_tweak_general(
 	}
 }
 
-#define BASE_CLEANUP() for (it = 0; it < options_used; it++) if(options[it].arg != NULL) free(options[it].arg); DESTROY_STACK(next); DESTROY_STACK(fail); panda_assembler_unref(assembler); panda_log_proxy_unref(logger); panda_writer_unref(data.writer_out); panda_writer_unref(data.writer_err); free(combined_general_args)
+/* Read a list of tags and file names, opening each file only once, even if it has many tags. */
+static PandaDemux open_demux(
+	const char *filename,
+	PandaOutputSeq output,
+	PandaWriter unknown,
+	PandaLogProxy logger) {
+	FILE *file;
+	char line[1024];
+	int line_number = 0;
+	PandaDemux demux = NULL;
+	struct {
+		char tag[PANDA_TAG_LEN];
+		char name[sizeof(line)];
+		PandaWriter writer;
+	} *samples = NULL;
+	size_t samples_length = 0;
+	size_t it;
+	bool ok = true;
+
+	if ((file = fopen(filename, "r")) == NULL) {
+		perror(filename);
+		return NULL;
+	}
+	while (fgets(line, sizeof(line), file) != NULL) {
+		char tag[sizeof(line)];
+		char name[sizeof(line)];
+		char extra;
+		int fields;
+		line_number++;
+		if (line[0] == '#' || (fields = sscanf(line, "%s %s %c", tag, name, &extra)) == EOF) {
+			continue;
+		}
+		if (fields != 2 || strlen(line) == sizeof(line) - 1 || strlen(tag) >= PANDA_TAG_LEN) {
+			fprintf(stderr, "Expected a tag and a file name on line %d of %s.\n", line_number, filename);
+			ok = false;
+			break;
+		}
+		for (it = 0; it < samples_length && strcmp(samples[it].tag, tag) != 0; it++) ;
+		if (it < samples_length) {
+			fprintf(stderr, "Duplicate tag %s on line %d of %s.\n", tag, line_number, filename);
+			ok = false;
+			break;
+		}
+		samples = realloc(samples, (samples_length + 1) * sizeof(*samples));
+		memcpy(samples[samples_length].tag, tag, strlen(tag) + 1);
+		memcpy(samples[samples_length].name, name, strlen(name) + 1);
+		for (it = 0; it < samples_length && strcmp(samples[it].name, name) != 0; it++) ;
+		if (it < samples_length) {
+			samples[samples_length++].writer = panda_writer_ref(samples[it].writer);
+		} else if ((samples[samples_length].writer = panda_writer_open_file(name, strlen(name) > 4 && strcmp(name + strlen(name) - 4, ".bz2") == 0)) != NULL) {
+			samples_length++;
+		} else {
+			perror(name);
+			ok = false;
+			break;
+		}
+	}
+	fclose(file);
+	if (ok) {
+		demux = panda_demux_new(output, unknown, logger);
+	}
+	for (it = 0; it < samples_length; it++) {
+		if (demux != NULL) {
+			panda_demux_add(demux, samples[it].tag, samples[it].writer);
+		}
+		panda_writer_unref(samples[it].writer);
+	}
+	free(samples);
+	return demux;
+}
+
+#define BASE_CLEANUP() for (it = 0; it < options_used; it++) if(options[it].arg != NULL) free(options[it].arg); DESTROY_STACK(next); DESTROY_STACK(fail); panda_assembler_unref(assembler); panda_log_proxy_unref(logger); panda_writer_unref(data.writer_out); panda_writer_unref(data.writer_err); panda_demux_unref(demux); free(combined_general_args)
 #ifdef HAVE_PTHREAD
 #        define CLEANUP() BASE_CLEANUP(); panda_mux_unref(mux)
 #else
@@ -440,6 +517,7 @@ bool panda_parse_args(
 	size_t combined_general_args_length = 0;
 	struct data data;
 	PandaLogProxy logger = NULL;
+	PandaDemux demux = NULL;
 	size_t it;
 #ifdef HAVE_PTHREAD
 	PandaMux mux = NULL;
@@ -461,6 +539,7 @@ bool panda_parse_args(
 	data.help = false;
 	data.num_kmers = PANDA_DEFAULT_NUM_KMERS;
 	data.version = false;
+	data.demux_filename = NULL;
 	data.writer_out = panda_writer_new_stdout();
 	data.writer_err = panda_writer_new_stderr();
 #ifdef HAVE_PTHREAD
@@ -571,6 +650,10 @@ bool panda_parse_args(
 		fail_data = NULL;
 		fail_destroy = NULL;
 	}
+	if (output != NULL && data.demux_filename != NULL && (demux = open_demux(data.demux_filename, (PandaOutputSeq) (data.fastq ? panda_output_fastq : panda_output_fasta), data.writer_out, logger)) == NULL) {
+		CLEANUP();
+		return false;
+	}
 	if (out_mux) {
 #if HAVE_PTHREAD
 		*out_mux = mux;
@@ -589,10 +672,17 @@ bool panda_parse_args(
 #else
 	MAYBE(out_threads) = 1;
 #endif
-	MAYBE(output) = (PandaOutputSeq) (data.fastq ? panda_output_fastq : panda_output_fasta);
-	MAYBE(output_data) = data.writer_out;
-	MAYBE(output_destroy) = (PandaDestroy) panda_writer_unref;
-	data.writer_out = NULL;
+	if (demux != NULL) {
+		MAYBE(output) = (PandaOutputSeq) panda_output_demux;
+		MAYBE(output_data) = demux;
+		MAYBE(output_destroy) = (PandaDestroy) panda_demux_unref;
+		demux = NULL;
+	} else {
+		MAYBE(output) = (PandaOutputSeq) (data.fastq ? panda_output_fastq : panda_output_fasta);
+		MAYBE(output_data) = data.writer_out;
+		MAYBE(output_destroy) = (PandaDestroy) panda_writer_unref;
+		data.writer_out = NULL;
+	}
 
 	CLEANUP();
 	return true;
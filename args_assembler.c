@@ -103,6 +103,31 @@ static bool set_primer_penalty(
 
 const panda_tweak_assembler panda_stdargs_primer_penalty = { 'D', "threshold", "Penalise primers if the further they are from the start of the sequence.", set_primer_penalty, false };
 
+static bool set_primer_expected(
+	PandaAssembler assembler,
+	char flag,
+	char *argument) {
+	long expected;
+
+	(void) flag;
+	if (argument == NULL) {
+		return true;
+	}
+	errno = 0;
+	expected = strtol(argument, NULL, 10);
+	if (errno != 0 || expected < 0 || expected > 16) {
+		fprintf(stderr, "Bad number of primer offsets. It should be between 0 and 16.\n");
+		free(argument);
+		return false;
+	}
+
+	panda_assembler_set_primer_expected(assembler, expected);
+	free(argument);
+	return true;
+}
+
+const panda_tweak_assembler panda_stdargs_primer_expected = { 'E', "count", "Check for the primers at this many of the most common offsets first and use the first one that is good enough.", set_primer_expected, false };
+
 bool no_n_check(
 	PandaLogProxy logger,
 	const panda_result_seq *sequence,
@@ -141,6 +166,7 @@ static bool set_degenerates(
 	char flag,
 	char *argument) {
 	PandaModule m = panda_module_new("DEGENERATE", no_n_check, NULL, NULL, NULL);
+	panda_module_set_uses_sequence(m, false);
 	(void) flag;
 	panda_assembler_add_module(assembler, m);
 	panda_module_unref(m);
@@ -174,6 +200,75 @@ static bool set_threshold(
 
 const panda_tweak_assembler panda_stdargs_threshold = { 't', "threshold", "The minimum probability that a sequence must have to assemble and, if used, match a primer.", set_threshold, false };
 
+/* Read a FASTA file of named primers. The name of each primer is the whole header line. */
+static bool read_primers(
+	PandaAssembler assembler,
+	const char *filename,
+	char *direction,
+	void (*add_func) (PandaAssembler,
+		const char *,
+		const panda_nt *,
+		size_t),
+	panda_nt (*parse) (char)) {
+	void *read_data;
+	PandaDestroy read_destroy;
+	PandaBufferRead read = panda_open_buffer(filename, panda_assembler_get_logger(assembler), &read_data, &read_destroy);
+	PandaLineBuf linebuf;
+	char *name = NULL;
+	panda_nt sequence[PANDA_MAX_LEN];
+	size_t sequence_length = 0;
+	size_t count = 0;
+	bool success = true;
+
+	if (read == NULL) {
+		return false;
+	}
+	linebuf = panda_linebuf_new(read, read_data, read_destroy);
+	while (success) {
+		const char *line = panda_linebuf_next(linebuf);
+		size_t it;
+		if (line == NULL || line[0] == '>') {
+			if (name != NULL) {
+				if (sequence_length == 0) {
+					fprintf(stderr, "ERR\tBADPRIMER\t%cPRIMER\t%s\n", (int) toupper(direction[0]), name);
+					success = false;
+					break;
+				}
+				add_func(assembler, name, sequence, sequence_length);
+				count++;
+				free(name);
+				name = NULL;
+			}
+			if (line == NULL) {
+				break;
+			}
+			name = malloc(strlen(line));
+			strcpy(name, line + 1);
+			sequence_length = 0;
+		} else if (line[0] != '\0') {
+			if (name == NULL || sequence_length + strlen(line) >= (size_t) PANDA_MAX_LEN) {
+				fprintf(stderr, "ERR\tBADPRIMER\t%cPRIMER\t%s\n", (int) toupper(direction[0]), line);
+				success = false;
+				break;
+			}
+			for (it = 0; line[it] != '\0'; it++) {
+				if ((sequence[sequence_length++] = parse(line[it])) == '\0') {
+					fprintf(stderr, "ERR\tBADNT\t%cPRIMER\n", (int) toupper(direction[0]));
+					success = false;
+					break;
+				}
+			}
+		}
+	}
+	free(name);
+	panda_linebuf_free(linebuf);
+	if (success && count == 0) {
+		fprintf(stderr, "No %s primers in %s.\n", direction, filename);
+		success = false;
+	}
+	return success;
+}
+
 static bool set_primer(
 	PandaAssembler assembler,
 	char *argument,
@@ -183,10 +278,19 @@ static bool set_primer(
 	void (*set_func) (PandaAssembler,
 		panda_nt *,
 		size_t),
+	void (*add_func) (PandaAssembler,
+		const char *,
+		const panda_nt *,
+		size_t),
 	panda_nt (*parse) (char)) {
 	if (argument != NULL) {
 		char *endptr;
 		size_t offset;
+		if (argument[0] == '@') {
+			bool success = read_primers(assembler, argument + 1, direction, add_func, parse);
+			free(argument);
+			return success;
+		}
 		errno = 0;
 		offset = strtol(argument, &endptr, 10);
 		if (*endptr != '\0') {
@@ -217,9 +321,9 @@ static bool set_primer_group(
 	char flag,
 	char *argument) {
 	if (flag == 'p') {
-		return set_primer(assembler, argument, "forward", panda_assembler_set_forward_trim, panda_assembler_set_forward_primer, panda_nt_from_ascii);
+		return set_primer(assembler, argument, "forward", panda_assembler_set_forward_trim, panda_assembler_set_forward_primer, panda_assembler_add_forward_primer, panda_nt_from_ascii);
 	} else if (flag == 'q') {
-		return set_primer(assembler, argument, "reverse", panda_assembler_set_reverse_trim, panda_assembler_set_reverse_primer, panda_nt_from_ascii_complement);
+		return set_primer(assembler, argument, "reverse", panda_assembler_set_reverse_trim, panda_assembler_set_reverse_primer, panda_assembler_add_reverse_primer, panda_nt_from_ascii_complement);
 	}
 	if (argument != NULL) {
 		free(argument);
@@ -227,8 +331,8 @@ static bool set_primer_group(
 	return false;
 }
 
-const panda_tweak_assembler panda_stdargs_forward_primer = { 'p', "primer", "Forward primer sequence or number of bases to be removed.", set_primer_group, false };
-const panda_tweak_assembler panda_stdargs_reverse_primer = { 'q', "primer", "Reverse primer sequence or number of bases to be removed.", set_primer_group, false };
+const panda_tweak_assembler panda_stdargs_forward_primer = { 'p', "primer", "Forward primer sequence, @ followed by a FASTA file of named primers, or number of bases to be removed.", set_primer_group, false };
+const panda_tweak_assembler panda_stdargs_reverse_primer = { 'q', "primer", "Reverse primer sequence, @ followed by a FASTA file of named primers, or number of bases to be removed.", set_primer_group, false };
 
 bool short_check(
 	PandaLogProxy logger,
@@ -257,6 +361,7 @@ static bool set_short_check(
 		return false;
 	}
 	m = panda_module_new("SHORT", short_check, NULL, (void *) (size_t) minlen, NULL);
+	panda_module_set_uses_sequence(m, false);
 	panda_assembler_add_module(assembler, m);
 	panda_module_unref(m);
 	free(argument);
@@ -294,6 +399,7 @@ static bool set_long_check(
 	}
 
 	m = panda_module_new("LONG", long_check, NULL, (void *) maxlen, NULL);
+	panda_module_set_uses_sequence(m, false);
 	panda_assembler_add_module(assembler, m);
 	panda_module_unref(m);
 	free(argument);
@@ -302,6 +408,93 @@ static bool set_long_check(
 
 const panda_tweak_assembler panda_stdargs_max_len = { 'L', "length", "Maximum length for a sequence.", set_long_check, false };
 
+static bool set_kmer_length(
+	PandaAssembler assembler,
+	char flag,
+	char *argument) {
+	long kmer_length;
+
+	(void) flag;
+	if (argument == NULL) {
+		return true;
+	}
+	errno = 0;
+	kmer_length = strtol(argument, NULL, 10);
+	if (errno != 0 || kmer_length < PANDA_MIN_KMER_LENGTH || kmer_length > PANDA_MAX_KMER_LENGTH) {
+		fprintf(stderr, "Bad k-mer length. It must be between %d and %d.\n", PANDA_MIN_KMER_LENGTH, PANDA_MAX_KMER_LENGTH);
+		free(argument);
+		return false;
+	}
+
+	panda_assembler_set_kmer_length(assembler, kmer_length);
+	free(argument);
+	return true;
+}
+
+const panda_tweak_assembler panda_stdargs_kmer_length = { 'K', "length", "The length of the k-mers used to find candidate overlaps.", set_kmer_length, false };
+
+static const char *const seed_names[] = { "kmer", "spaced", "short", "all" };
+
+static bool set_seed_policy(
+	PandaAssembler assembler,
+	char flag,
+	char *argument) {
+	PandaSeedPolicy policy = 0;
+	char *name;
+	char *next;
+
+	(void) flag;
+	if (argument == NULL) {
+		return true;
+	}
+	for (name = argument; name != NULL; name = next) {
+		PandaSeed seed;
+		next = strchr(name, ',');
+		if (next != NULL) {
+			*next = '\0';
+			next++;
+		}
+		for (seed = PANDA_SEED_KMER; seed <= PANDA_SEED_ALL && strcmp(name, seed_names[seed]) != 0; seed++) ;
+		if (seed > PANDA_SEED_ALL) {
+			fprintf(stderr, "Unknown seeding method \"%s\". It must be one of kmer, spaced, short, or all.\n", name);
+			free(argument);
+			return false;
+		}
+		policy |= PANDA_SEED_POLICY(seed);
+	}
+
+	panda_assembler_set_seed_policy(assembler, policy);
+	free(argument);
+	return true;
+}
+
+const panda_tweak_assembler panda_stdargs_seed_policy = { 'S', "kmer,spaced,short,all", "The ways to find candidate overlaps, each tried in this order until one finds some. The default is kmer,all.", set_seed_policy, false };
+
+static bool set_overlap_warmup(
+	PandaAssembler assembler,
+	char flag,
+	char *argument) {
+	long warmup;
+
+	(void) flag;
+	if (argument == NULL) {
+		return true;
+	}
+	errno = 0;
+	warmup = strtol(argument, NULL, 10);
+	if (errno != 0 || warmup < 0) {
+		fprintf(stderr, "Bad number of sequences.\n");
+		free(argument);
+		return false;
+	}
+
+	panda_assembler_set_overlap_warmup(assembler, warmup);
+	free(argument);
+	return true;
+}
+
+const panda_tweak_assembler panda_stdargs_overlap_warmup = { 'H', "count", "After this many sequences are assembled, look for overlaps near the most common one first and stop once one is good enough.", set_overlap_warmup, false };
+
 static bool set_minimum_overlap(
 	PandaAssembler assembler,
 	char flag,
@@ -356,9 +549,13 @@ const panda_tweak_assembler *const panda_stdargs[] = {
 	&panda_stdargs_algorithm,
 	&panda_stdargs_module,
 	&panda_stdargs_primer_penalty,
+	&panda_stdargs_primer_expected,
+	&panda_stdargs_overlap_warmup,
+	&panda_stdargs_kmer_length,
 	&panda_stdargs_max_len,
 	&panda_stdargs_degenerates,
 	&panda_stdargs_max_overlap,
+	&panda_stdargs_seed_policy,
 	&panda_stdargs_primers_after,
 	&panda_stdargs_min_len,
 	&panda_stdargs_min_overlap,
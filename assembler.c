@@ -20,6 +20,7 @@
 #include <limits.h>
 #include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "pandaseq.h"
@@ -31,40 +32,344 @@
 #include "prob.h"
 #include "table.h"
 
-#define LOG(flag, code) do { if(panda_debug_flags & flag) panda_log_proxy_write(assembler->logger, (code), assembler, &assembler->result.name, NULL); } while(0)
-#define LOGV(flag, code, fmt, ...) do { if(panda_debug_flags & flag) { snprintf(static_buffer(), BUFFER_SIZE, fmt, __VA_ARGS__); panda_log_proxy_write(assembler->logger, (code), assembler, &assembler->result.name, static_buffer()); }} while(0)
+#define LOG(flag, code) do { if(panda_debug_flags & flag) panda_log_proxy_write(assembler->logger, (code), assembler, &result->name, NULL); } while(0)
+#define LOGV(flag, code, fmt, ...) do { if(panda_debug_flags & flag) { snprintf(static_buffer(), BUFFER_SIZE, fmt, __VA_ARGS__); panda_log_proxy_write(assembler->logger, (code), assembler, &result->name, static_buffer()); }} while(0)
 
-typedef unsigned int bitstype;
-#define FOR_BITS_IN_LIST(bits,index) for (index = 0; index < bits##_size; index++) if ((bits)[index / sizeof(bitstype) / 8] & (1 << (index % (8 * sizeof(bitstype)))))
-#define BIT_LIST_SET(bits,index) do { if ((index) >= 0 && (size_t)(index) < bits##_size) { (bits)[(index) / sizeof(bitstype) / 8] |= (1 << ((index) % (8 * sizeof(bitstype)))); } } while (0)
-#define BIT_LIST_GET(bits,index) ((bits)[(index) / sizeof(bitstype) / 8] & (1 << ((index) % (8 * sizeof(bitstype)))))
-#define BITS_INIT(bits,size) bitstype bits[(size) / 8 / sizeof(bitstype) + 1]; size_t bits##_size = (size); memset(&bits, 0, ((size) / 8 / sizeof(bitstype) + 1) * sizeof(bitstype))
-#define ALL_BITS_IF_NONE(bits) do { bitstype _all = 0; size_t _bitctr; for (_bitctr = 0; _bitctr < ((bits##_size) / 8 / sizeof(bitstype) + 1); _bitctr++) { _all |= (bits)[_bitctr]; } if (_all == 0) { memset(&bits, 0xFF, (bits##_size / 8 / sizeof(bitstype) + 1) * sizeof(bitstype)); }} while (0)
+/* The number of k-mers shared by the reads at each candidate overlap, indexed from the minimum overlap. */
+#define SUPPORT_INIT(support,size) unsigned int support[size]; size_t support##_size = (size); memset(&support, 0, sizeof(support))
+#define SUPPORT_ADD(support,index) do { if ((index) >= 0 && (size_t)(index) < support##_size) { (support)[(index)]++; } } while (0)
+
+/*
+ * Count the k-mers shared between the reads that support each overlap. A copy is generated for every supported k-mer length, so the k-mer mask and the number of bases needed to fill a k-mer are constants in each.
+ */
+typedef void (
+	*seed_func) (
+	PandaAssembler assembler,
+	panda_result_seq *result,
+	unsigned int *support,
+	size_t support_size);
+
+#define SEED_FUNCTION(k) \
+	static void seed_ ## k(PandaAssembler assembler, panda_result_seq *result, unsigned int *support, size_t support_size) { \
+		kmer_it it; \
+		size_t j; \
+		/* Scan forward sequence building k-mers and storing their positions in the index. */ \
+		kmer_index_reset(&assembler->kmers, result->forward_length); \
+		_FOREACH_KMER(it, assembler->forward_arrays.nt,, 0, k, < (ptrdiff_t) result->forward_length, ++, k) { \
+			LOGV(PANDA_DEBUG_KMER, PANDA_CODE_FORWARD_KMER, "%zd@%zd", KMER(it), KMER_POSITION(it)); \
+			if (!kmer_index_add(&assembler->kmers, KMER(it), KMER_POSITION(it))) { \
+				/* If we run out of storage, we lose k-mers. */ \
+				LOGV(PANDA_DEBUG_BUILD, PANDA_CODE_LOST_KMER, "%zd@%zd", KMER(it), KMER_POSITION(it)); \
+			} \
+		} \
+		/* Scan reverse sequence building k-mers. For each position in the forward sequence for this k-mer, add support to the corresponding overlap. */ \
+		_FOREACH_KMER(it, assembler->reverse_arrays.nt,, result->reverse_length - 1, k, >= 0, --, k) { \
+			const seqindex *positions; \
+			size_t positions_length; \
+			LOGV(PANDA_DEBUG_KMER, PANDA_CODE_REVERSE_KMER, "%zd@%zd", KMER(it), KMER_POSITION(it)); \
+			positions_length = kmer_index_find(&assembler->kmers, KMER(it), &positions); \
+			for (j = 0; j < positions_length; j++) { \
+				int index = result->forward_length + result->reverse_length - KMER_POSITION(it) - positions[j] - assembler->minoverlap - 1; \
+				SUPPORT_ADD(support, index); \
+			} \
+		} \
+	}
+
+SEED_FUNCTION(6)
+SEED_FUNCTION(7)
+SEED_FUNCTION(8)
+SEED_FUNCTION(9)
+SEED_FUNCTION(10)
+SEED_FUNCTION(11)
+SEED_FUNCTION(12)
+SEED_FUNCTION(13)
+SEED_FUNCTION(14)
+SEED_FUNCTION(15)
+SEED_FUNCTION(16)
+
+static const seed_func seeders[PANDA_MAX_KMER_LENGTH - PANDA_MIN_KMER_LENGTH + 1] = {
+	seed_6, seed_7, seed_8, seed_9, seed_10, seed_11, seed_12, seed_13, seed_14, seed_15, seed_16
+};
+
+/*
+ * The offsets of the bases used in a spaced seed. With eight bases out of eleven, a seed is as specific as an 8-mer, but an error in any of the other bases does not stop it from matching.
+ */
+static const size_t spaced_seed[] = { 0, 1, 3, 4, 6, 7, 9, 10 };
+
+#define SPACED_SEED_SPAN 11
+
+/* Compute the key of the spaced seed starting at a position and reading in the direction supplied. Returns false if it includes an N. */
+static bool spaced_seed_key(
+	const panda_nt *sequence,
+	ptrdiff_t start,
+	ptrdiff_t direction,
+	size_t *key) {
+	size_t it;
+	*key = 0;
+	for (it = 0; it < sizeof(spaced_seed) / sizeof(*spaced_seed); it++) {
+		panda_nt nt = sequence[start + direction * (ptrdiff_t) spaced_seed[it]];
+		if (PANDA_NT_IS_N(nt)) {
+			return false;
+		}
+		*key = (*key << 2) | (nt == PANDA_NT_T ? 3 : nt == PANDA_NT_G ? 2 : nt == PANDA_NT_C ? 1 : 0);
+	}
+	return true;
+}
+
+/* Count the spaced seeds shared between the reads that support each overlap. A seed reads forward from its start in the forward read and backward from its start in the reverse read, so the start positions play the same role as k-mer positions. */
+static void seed_spaced(
+	PandaAssembler assembler,
+	panda_result_seq *result,
+	unsigned int *support,
+	size_t support_size) {
+	ptrdiff_t position;
+	size_t key;
+	size_t j;
+	kmer_index_reset(&assembler->kmers, result->forward_length);
+	for (position = 0; position + SPACED_SEED_SPAN <= (ptrdiff_t) result->forward_length; position++) {
+		if (spaced_seed_key(assembler->forward_arrays.nt, position, 1, &key)) {
+			LOGV(PANDA_DEBUG_KMER, PANDA_CODE_FORWARD_KMER, "%zd@%zd", key, position);
+			if (!kmer_index_add(&assembler->kmers, key, position)) {
+				LOGV(PANDA_DEBUG_BUILD, PANDA_CODE_LOST_KMER, "%zd@%zd", key, position);
+			}
+		}
+	}
+	for (position = result->reverse_length - 1; position + 1 >= SPACED_SEED_SPAN; position--) {
+		if (spaced_seed_key(assembler->reverse_arrays.nt, position, -1, &key)) {
+			const seqindex *positions;
+			size_t positions_length;
+			LOGV(PANDA_DEBUG_KMER, PANDA_CODE_REVERSE_KMER, "%zd@%zd", key, position);
+			positions_length = kmer_index_find(&assembler->kmers, key, &positions);
+			for (j = 0; j < positions_length; j++) {
+				int index = result->forward_length + result->reverse_length - position - positions[j] - assembler->minoverlap - 1;
+				SUPPORT_ADD(support, index);
+			}
+		}
+	}
+}
+
+/* Put the overlaps with the most support first, and the shortest first among equals. */
+static int compare_support(
+	const void *a,
+	const void *b) {
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+	return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/* Put the overlaps closest to the most common overlap first, and the shortest first among equals. */
+static int compare_distance(
+	const void *a,
+	const void *b) {
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/* Compute the probability of some candidate overlaps and return the best, if it is better than the best probability supplied. Among equally good overlaps, the shortest wins, no matter the order of the candidates. */
+static ptrdiff_t score_overlaps(
+	PandaAssembler assembler,
+	panda_result_seq *result,
+	const size_t *overlaps,
+	size_t overlaps_length,
+	double *bestprobability) {
+	void *algo_data = panda_algorithm_data(assembler->algo);
+	PandaComputeOverlap overlap_probability = assembler->algo->clazz->overlap_probability;
+	PandaComputeOverlapCounts overlap_counts = assembler->algo->clazz->overlap_counts;
+	PandaComputeOverlapBatch overlap_probability_batch = assembler->algo->clazz->overlap_probability_batch;
+	const overlap_table *table = algorithm_overlap_table(assembler->algo);
+	ptrdiff_t bestoverlap = -1;
+	size_t i;
+
+	if (table != NULL || overlap_probability_batch != NULL) {
+		double probabilities[overlaps_length];
+		bool log_probabilities = (panda_debug_flags & PANDA_DEBUG_RECON) != 0;
+		if (table != NULL) {
+			bestoverlap = overlap_reads_best(table, &assembler->overlap_reads, overlaps, overlaps_length, bestprobability, log_probabilities ? probabilities : NULL);
+		} else {
+			bestoverlap = overlap_probability_batch(algo_data, result->forward, result->forward_length, result->reverse, result->reverse_length, overlaps, overlaps_length, bestprobability, log_probabilities ? probabilities : NULL);
+		}
+		if (log_probabilities) {
+			for (i = 0; i < overlaps_length; i++) {
+				LOGV(PANDA_DEBUG_RECON, PANDA_CODE_OVERLAP_POSSIBILITY, "overlap = %zd probability = %f", overlaps[i], probabilities[i]);
+			}
+		}
+		return bestoverlap;
+	}
+	for (i = 0; i < overlaps_length; i++) {
+		double probability;
+		size_t overlap = overlaps[i];
+		if (overlap_counts != NULL) {
+			size_t matches;
+			size_t mismatches;
+			size_t unknowns;
+			packed_seq_count(&assembler->forward_packed, &assembler->reverse_packed, overlap, &matches, &mismatches, &unknowns);
+			probability = overlap_counts(algo_data, result->forward_length, result->reverse_length, overlap, matches, mismatches, unknowns);
+		} else {
+			probability = overlap_probability(algo_data, result->forward, result->forward_length, result->reverse, result->reverse_length, overlap);
+		}
+
+		LOGV(PANDA_DEBUG_RECON, PANDA_CODE_OVERLAP_POSSIBILITY, "overlap = %zd probability = %f", overlap, probability);
+		if (probability > *bestprobability || (probability == *bestprobability && bestoverlap != -1 && overlap < (size_t) bestoverlap)) {
+			*bestprobability = probability;
+			bestoverlap = overlap;
+		}
+	}
+	return bestoverlap;
+}
+
+/* Decide if an overlap near the most common one is good enough to stop looking for others: at least the threshold fraction of the known bases in it must match. */
+static bool overlap_is_convincing(
+	PandaAssembler assembler,
+	panda_result_seq *result,
+	size_t overlap) {
+	size_t matches;
+	size_t mismatches;
+	size_t unknowns;
+	count_overlap(result->forward, result->forward_length, result->reverse, result->reverse_length, overlap, &matches, &mismatches, &unknowns);
+	return matches > 0 && matches >= exp(assembler->threshold) * (matches + mismatches);
+}
 
 #define VEEZ(x) ((x) < 0 ? 0 : (x))
 #define WEDGEZ(x) ((x) > 0 ? 0 : (x))
+/* Store a base of the assembled sequence in whichever forms the assembler is producing. */
+#define STORE_BASE(sequence, compact, index, base, probability, phred_score) do { if ((sequence) != NULL) { (sequence)[(index)].nt = (base); (sequence)[(index)].p = (probability); } if ((compact) != NULL) { (compact)[(index)].nt = (base); (compact)[(index)].phred = (phred_score); } } while (0)
+
+static char probability_phred(
+	double p) {
+	panda_result base;
+	base.nt = '\0';
+	base.p = p;
+	return panda_result_phred(&base);
+}
 
-/* Try to align forward and reverse reads and return the quality of the aligned sequence and the sequence itself. */
-static bool align(
+void assembler_prepare_algorithm(
+	PandaAssembler assembler) {
+	void *algo_data = panda_algorithm_data(assembler->algo);
+	PandaComputeMatch match_probability = assembler->algo->clazz->match_probability;
+	double qual_nn = assembler->algo->clazz->prob_unpaired;
+	int a;
+	int b;
+	for (a = 0; a <= PHREDMAX; a++) {
+		for (b = 0; b <= PHREDMAX; b++) {
+			double match = match_probability(algo_data, true, (char) a, (char) b);
+			double mismatch = match_probability(algo_data, false, (char) a, (char) b);
+			assembler->match_table[true][a][b] = match;
+			assembler->match_table[false][a][b] = mismatch;
+			assembler->match_phred[true][a][b] = probability_phred(match);
+			assembler->match_phred[false][a][b] = probability_phred(mismatch);
+		}
+		assembler->score_phred[a] = probability_phred(qual_score[a]);
+	}
+	assembler->unpaired_phred = probability_phred(qual_nn);
+}
+
+/* Copy the overlapping bases into the sequence and return the sum of their probabilities. If the algorithm's match probabilities are fixed, the table of them is supplied. This is inlined separately with and without the table, so each copy has only one way of computing a probability. */
+__attribute__ ((always_inline))
+static inline double build_overlap(
+	PandaAssembler assembler,
+	panda_result_seq *result,
+	ptrdiff_t bestoverlap,
+	ptrdiff_t df,
+	ptrdiff_t dr,
+	size_t unmasked_forward_length,
+	size_t unmasked_reverse_length,
+	panda_result *sequence,
+	panda_result_compact *compact,
+	double (*match_table)[PHREDMAX + 1][PHREDMAX + 1]) {
+	double qual_nn = assembler->algo->clazz->prob_unpaired;
+	void *algo_data = panda_algorithm_data(assembler->algo);
+	PandaComputeMatch match_probability = assembler->algo->clazz->match_probability;
+	ptrdiff_t length = bestoverlap + WEDGEZ(df) + WEDGEZ(dr);
+	double oquality = 0;
+	ptrdiff_t i;
+
+	result->overlap_mismatches = 0;
+	/* Stop where either read runs out, rather than checking every base. */
+	if (length > (ptrdiff_t) result->forward_length - (ptrdiff_t) result->forward_offset - VEEZ(df)) {
+		length = (ptrdiff_t) result->forward_length - (ptrdiff_t) result->forward_offset - VEEZ(df);
+	}
+	if (length > (ptrdiff_t) result->reverse_length + WEDGEZ(df)) {
+		length = (ptrdiff_t) result->reverse_length + WEDGEZ(df);
+	}
+	for (i = 0; i < length; i++) {
+		ptrdiff_t index = VEEZ(df) + i;
+		size_t findex = result->forward_offset + VEEZ(df) + i;
+		size_t rindex = result->reverse_length - i - 1 + WEDGEZ(df);
+		panda_nt forward_nt = assembler->forward_arrays.nt[findex];
+		panda_nt reverse_nt = assembler->reverse_arrays.nt[rindex];
+		char forward_qual = assembler->forward_arrays.qual[findex];
+		char reverse_qual = assembler->reverse_arrays.qual[rindex];
+		bool ismatch = (reverse_nt & forward_nt) != '\0';
+		double q;
+		char phred;
+		char nt;
+
+		if (!ismatch) {
+			LOGV(PANDA_DEBUG_MISMATCH, PANDA_CODE_MISMATCHED_BASE, "(F[%zd] = %c) != (R[%zd] = %c)", findex, panda_nt_to_ascii(forward_nt), rindex, panda_nt_to_ascii(reverse_nt));
+			result->overlap_mismatches++;
+		}
+
+		if (findex >= unmasked_forward_length && rindex >= unmasked_reverse_length) {
+			q = qual_nn;
+			phred = assembler->unpaired_phred;
+		} else if (findex >= unmasked_forward_length) {
+			q = qual_score[PHREDCLAMP(reverse_qual)];
+			phred = assembler->score_phred[PHREDCLAMP(reverse_qual)];
+		} else if (rindex >= unmasked_reverse_length) {
+			q = qual_score[PHREDCLAMP(forward_qual)];
+			phred = assembler->score_phred[PHREDCLAMP(forward_qual)];
+		} else if (match_table != NULL) {
+			q = match_table[ismatch][PHREDCLAMP(forward_qual)][PHREDCLAMP(reverse_qual)];
+			phred = assembler->match_phred[ismatch][PHREDCLAMP(forward_qual)][PHREDCLAMP(reverse_qual)];
+		} else {
+			q = match_probability(algo_data, ismatch, forward_qual, reverse_qual);
+			phred = compact == NULL ? '\0' : probability_phred(q);
+		}
+
+		if (ismatch) {
+			nt = (reverse_nt & forward_nt);
+		} else if (forward_qual < reverse_qual) {
+			nt = reverse_nt;
+		} else {
+			nt = forward_nt;
+		}
+		STORE_BASE(sequence, compact, index, nt, q, phred);
+		if (PANDA_NT_IS_DEGN(nt)) {
+			result->degenerates++;
+		}
+		oquality += q;
+		LOGV(PANDA_DEBUG_RECON, PANDA_CODE_BUILD_OVERLAP, "S[%zd] = %c, F[%zd] = %c, R[%zd] = %c", index, panda_nt_to_ascii(nt), findex, panda_nt_to_ascii(forward_nt), rindex, panda_nt_to_ascii(reverse_nt));
+	}
+	return oquality;
+}
+
+/* Try to align forward and reverse reads and return the quality of the aligned sequence and the sequence itself, or the reason it was rejected. */
+static PandaReject align(
 	PandaAssembler assembler,
 	panda_result_seq *result) {
 	size_t i, j;
 	ptrdiff_t df, dr;
 	/* Cache all algorithm information. */
 	double qual_nn = assembler->algo->clazz->prob_unpaired;
-	void *algo_data = panda_algorithm_data(assembler->algo);
-	PandaComputeOverlap overlap_probability = assembler->algo->clazz->overlap_probability;
-	PandaComputeMatch match_probability = assembler->algo->clazz->match_probability;
+	PandaComputeOverlapCounts overlap_counts = assembler->algo->clazz->overlap_counts;
+	PandaComputeOverlapBatch overlap_probability_batch = assembler->algo->clazz->overlap_probability_batch;
+	const overlap_table *table = algorithm_overlap_table(assembler->algo);
 	/* For determining overlap. */
 	size_t maxoverlap = result->forward_length + result->reverse_length - assembler->minoverlap - result->forward_offset - result->reverse_offset - 1;
 	double bestprobability = qual_nn * (result->forward_length + result->reverse_length);
 	ptrdiff_t bestoverlap = -1;
 	size_t counter;
-	kmer_it it;
+	size_t overlaps_length = 0;
+	PandaSeed seed;
+	/* Once enough sequences have been assembled, use the distribution of their overlaps to guess where to look. */
+	bool use_prior = assembler->overlap_warmup > 0 && assembler->okcount >= (long) assembler->overlap_warmup;
 	size_t unmasked_forward_length;
 	size_t unmasked_reverse_length;
 
 	/* For computing new sequence. */
+	panda_result *sequence = assembler_needs_probabilities(assembler) ? result->sequence : NULL;
+	panda_result_compact *compact = assembler->compact_results ? result->compact : NULL;
 	double fquality = 0;
 	double oquality = 0;
 	double rquality = 0;
@@ -72,7 +377,7 @@ static bool align(
 
 	if (assembler->minoverlap + result->forward_offset >= result->forward_length || assembler->minoverlap + result->reverse_offset >= result->reverse_length) {
 		LOG(PANDA_DEBUG_BUILD, PANDA_CODE_NEGATIVE_SEQUENCE_LENGTH);
-		return false;
+		return PANDA_REJECT_NO_ALIGNMENT;
 	}
 
 	if (assembler->maxoverlap == 0) {
@@ -81,56 +386,111 @@ static bool align(
 		maxoverlap = assembler->maxoverlap;
 	}
 
-	BITS_INIT(posn, assembler->minoverlap <= maxoverlap ? (maxoverlap - assembler->minoverlap + 1) : 1);
+	SUPPORT_INIT(support, assembler->minoverlap <= maxoverlap ? (maxoverlap - assembler->minoverlap + 1) : 1);
 
 	if (result->forward_length >= (1 << (8 * sizeof(seqindex)))) {
 		LOG(PANDA_DEBUG_BUILD, PANDA_CODE_INSUFFICIENT_KMER_TABLE);
-		return false;
+		return PANDA_REJECT_NO_ALIGNMENT;
 	}
 
-	/* Scan forward sequence building k-mers and appending the position to kmerseen[k] */
-	FOREACH_KMER(it, result->forward,.nt) {
-		LOGV(PANDA_DEBUG_KMER, PANDA_CODE_FORWARD_KMER, "%zd@%zd", KMER(it), KMER_POSITION(it));
-		for (j = 0; j < assembler->num_kmers && assembler->kmerseen[(KMER(it) << 1) + j] != 0; j++) ;
-		if (j == assembler->num_kmers) {
-			/* If we run out of storage, we lose k-mers. */
-			LOGV(PANDA_DEBUG_BUILD, PANDA_CODE_LOST_KMER, "%zd@%zd", KMER(it), KMER_POSITION(it));
-		} else {
-			assembler->kmerseen[(KMER(it) * assembler->num_kmers) + j] = KMER_POSITION(it);
-		}
-	}
+	read_arrays_split(&assembler->forward_arrays, result->forward, result->forward_length);
+	read_arrays_split(&assembler->reverse_arrays, result->reverse, result->reverse_length);
 
-	/* Scan reverse sequence building k-mers. For each position in the forward sequence for this kmer (i.e., kmerseen[k]), flag that we should check the corresponding overlap. */
-	FOREACH_KMER_REVERSE(it, result->reverse,.nt) {
-		LOGV(PANDA_DEBUG_KMER, PANDA_CODE_REVERSE_KMER, "%zd@%zd", KMER(it), KMER_POSITION(it));
-		for (j = 0; j < assembler->num_kmers && assembler->kmerseen[(KMER(it) * assembler->num_kmers) + j] != (seqindex) 0; j++) {
-			int index = result->forward_length + result->reverse_length - KMER_POSITION(it) - assembler->kmerseen[(KMER(it) * assembler->num_kmers) + j] - assembler->minoverlap - 1;
-			BIT_LIST_SET(posn, index);
+	/* Try each way of finding candidate overlaps allowed by the policy until one finds some. */
+	size_t overlaps[support_size];
+	for (seed = PANDA_SEED_KMER; seed <= PANDA_SEED_ALL; seed++) {
+		if ((assembler->seed_policy & PANDA_SEED_POLICY(seed)) == 0) {
+			continue;
+		}
+		switch (seed) {
+		case PANDA_SEED_KMER:
+			seeders[assembler->kmer_length - PANDA_MIN_KMER_LENGTH] (assembler, result, support, support_size);
+			break;
+		case PANDA_SEED_SPACED:
+			seed_spaced(assembler, result, support, support_size);
+			break;
+		case PANDA_SEED_SHORT:
+			if (assembler->kmer_length > PANDA_MIN_KMER_LENGTH) {
+				seeders[(assembler->kmer_length - 2 < PANDA_MIN_KMER_LENGTH ? PANDA_MIN_KMER_LENGTH : assembler->kmer_length - 2) - PANDA_MIN_KMER_LENGTH] (assembler, result, support, support_size);
+			}
+			break;
+		case PANDA_SEED_ALL:
+			for (counter = 0; counter < support_size; counter++) {
+				overlaps[overlaps_length++] = counter + assembler->minoverlap;
+			}
+			break;
+		}
+		for (counter = 0; counter < support_size && seed != PANDA_SEED_ALL; counter++) {
+			if (support[counter] > 0) {
+				overlaps[overlaps_length++] = counter + assembler->minoverlap;
+			}
+		}
+		if (overlaps_length > 0) {
+			assembler->seedcount[seed]++;
+			break;
 		}
 	}
-
-	/* Reset kmerseen */
-	FOREACH_KMER(it, result->forward,.nt) {
-		for (j = 0; j < assembler->num_kmers; j++)
-			assembler->kmerseen[(KMER(it) * assembler->num_kmers) + j] = 0;
+	if (overlaps_length == 0) {
+		LOG(PANDA_DEBUG_BUILD, PANDA_CODE_NO_SEEDS);
+		return PANDA_REJECT_NO_ALIGNMENT;
 	}
 
-	ALL_BITS_IF_NONE(posn);
-
-	result->overlaps_examined = 0;
 	/* Compute the quality of the overlapping region for the various overlaps and pick the best one. */
-	FOR_BITS_IN_LIST(posn, counter) {
-		double probability;
-		size_t overlap = counter + assembler->minoverlap;
-		probability = overlap_probability(algo_data, result->forward, result->forward_length, result->reverse, result->reverse_length, overlap);
-
-		LOGV(PANDA_DEBUG_RECON, PANDA_CODE_OVERLAP_POSSIBILITY, "overlap = %zd probability = %f", overlap, probability);
-		if (probability > bestprobability && overlap >= assembler->minoverlap) {
-			bestprobability = probability;
-			bestoverlap = overlap;
+	if (!use_prior && seed != PANDA_SEED_ALL && overlap_probability_batch != NULL && (panda_debug_flags & PANDA_DEBUG_RECON) == 0) {
+		/* The batch computation can give up on overlaps that cannot beat the best one so far, so try the best supported ones first. The order does not change which overlap is chosen, only how quickly. */
+		uint64_t order[overlaps_length];
+		for (i = 0; i < overlaps_length; i++) {
+			order[i] = ((uint64_t) support[overlaps[i] - assembler->minoverlap] << 32) | (support_size - (overlaps[i] - assembler->minoverlap));
+		}
+		qsort(order, overlaps_length, sizeof(uint64_t), compare_support);
+		for (i = 0; i < overlaps_length; i++) {
+			overlaps[i] = support_size - (order[i] & UINT32_MAX) + assembler->minoverlap;
+		}
+	}
+	/* If the algorithm only needs to know how many bases match, pack the reads so the bases can be compared many at a time. */
+	if (overlap_probability_batch == NULL && overlap_counts != NULL) {
+		packed_seq_build(&assembler->forward_packed, result->forward, result->forward_length, false);
+		packed_seq_build(&assembler->reverse_packed, result->reverse, result->reverse_length, true);
+	}
+	/* If the algorithm scores from a table, decode the reads already split for it once, rather than for every batch of candidates. */
+	if (table != NULL) {
+		overlap_reads_prepare_arrays(&assembler->overlap_reads, &assembler->forward_arrays, &assembler->reverse_arrays);
+		overlap_reads_bound(&assembler->overlap_reads, table);
+	}
+	if (use_prior) {
+		/* Score the candidates closest to the most common overlap first, widening the search until one of them is good enough to keep or there are none left. */
+		uint64_t order[overlaps_length];
+		size_t radius = 1;
+		size_t distance;
+		for (i = 0; i < overlaps_length; i++) {
+			distance = overlaps[i] > assembler->overlap_mode ? overlaps[i] - assembler->overlap_mode : assembler->overlap_mode - overlaps[i];
+			order[i] = ((uint64_t) distance << 32) | overlaps[i];
+		}
+		qsort(order, overlaps_length, sizeof(uint64_t), compare_distance);
+		for (i = 0; i < overlaps_length; i++) {
+			overlaps[i] = order[i] & UINT32_MAX;
+		}
+		for (i = 0; i < overlaps_length; radius *= 2) {
+			ptrdiff_t overlap;
+			for (j = i; j < overlaps_length && (order[j] >> 32) <= radius; j++) ;
+			if (j == i) {
+				continue;
+			}
+			overlap = score_overlaps(assembler, result, overlaps + i, j - i, &bestprobability);
+			if (overlap != -1) {
+				bestoverlap = overlap;
+			}
+			i = j;
+			if (i < overlaps_length && bestoverlap != -1 && overlap_is_convincing(assembler, result, bestoverlap)) {
+				assembler->priorcount++;
+				break;
+			}
 		}
-		result->overlaps_examined++;
+		overlaps_length = i;
+	} else {
+		bestoverlap = score_overlaps(assembler, result, overlaps, overlaps_length, &bestprobability);
 	}
+	result->overlaps_examined = overlaps_length;
 
 	if (result->overlaps_examined == maxoverlap - assembler->minoverlap + 1) {
 		assembler->slowcount++;
@@ -139,18 +499,18 @@ static bool align(
 	LOGV(PANDA_DEBUG_BUILD, PANDA_CODE_BEST_OVERLAP, "%zd", bestoverlap);
 
 	if (bestoverlap == -1) {
-		return false;
+		return PANDA_REJECT_NO_ALIGNMENT;
 	}
 
 	/* Compute the correct alignment and the quality score of the entire sequence. */
 	len = result->forward_length - (ptrdiff_t) result->forward_offset - bestoverlap + result->reverse_length - (ptrdiff_t) result->reverse_offset + 1;
 	if (len <= 0) {
 		LOG(PANDA_DEBUG_BUILD, PANDA_CODE_NEGATIVE_SEQUENCE_LENGTH);
-		return false;
+		return PANDA_REJECT_NO_ALIGNMENT;
 	}
 	if ((size_t) len > 2 * PANDA_MAX_LEN) {
 		LOG(PANDA_DEBUG_BUILD, PANDA_CODE_SEQUENCE_TOO_LONG);
-		return false;
+		return PANDA_REJECT_NO_ALIGNMENT;
 	}
 	result->sequence_length = len - 1;
 	result->degenerates = 0;
@@ -161,204 +521,328 @@ static bool align(
 	LOGV(PANDA_DEBUG_RECON, PANDA_CODE_RECONSTRUCTION_PARAM, "bestoverlap = %zd, dforward = %zd, dreverse = %zd, len = %zd", bestoverlap, df, dr, len);
 	for (i = 0; i < (size_t) VEEZ(df); i++) {
 		int findex = i + result->forward_offset;
-		panda_nt fbits = result->forward[findex].nt;
-		double q = qual_score[PHREDCLAMP(result->forward[findex].qual)];
-		result->sequence[i].nt = fbits;
-		result->sequence[i].p = q;
+		panda_nt fbits = assembler->forward_arrays.nt[findex];
+		double q = qual_score[PHREDCLAMP(assembler->forward_arrays.qual[findex])];
+		STORE_BASE(sequence, compact, i, fbits, q, assembler->score_phred[PHREDCLAMP(assembler->forward_arrays.qual[findex])]);
 		if (PANDA_NT_IS_DEGN(fbits)) {
 			result->degenerates++;
 		}
 		fquality += q;
-		LOGV(PANDA_DEBUG_RECON, PANDA_CODE_BUILD_FORWARD, "S[%zd] = F[%d] = %c", i, findex, panda_nt_to_ascii(result->sequence[i].nt));
+		LOGV(PANDA_DEBUG_RECON, PANDA_CODE_BUILD_FORWARD, "S[%zd] = F[%d] = %c", i, findex, panda_nt_to_ascii(fbits));
 	}
 
 	/* Mask out the B-cliff at the end of sequences */
-	for (unmasked_forward_length = result->forward_length; unmasked_forward_length > 0 && result->forward[unmasked_forward_length - 1].qual == (char) 2; unmasked_forward_length--) ;
-	for (unmasked_reverse_length = result->reverse_length; unmasked_reverse_length > 0 && result->reverse[unmasked_reverse_length - 1].qual == (char) 2; unmasked_reverse_length--) ;
+	for (unmasked_forward_length = result->forward_length; unmasked_forward_length > 0 && assembler->forward_arrays.qual[unmasked_forward_length - 1] == (char) 2; unmasked_forward_length--) ;
+	for (unmasked_reverse_length = result->reverse_length; unmasked_reverse_length > 0 && assembler->reverse_arrays.qual[unmasked_reverse_length - 1] == (char) 2; unmasked_reverse_length--) ;
 
 	/* Copy the paired sequence adjusting the probabilities based on the quality information from both sequences. */
-	result->overlap_mismatches = 0;
-	for (i = 0; i < (size_t) (bestoverlap + WEDGEZ(df) + WEDGEZ(dr)); i++) {
-		int index = VEEZ(df) + i;
-		int findex = result->forward_offset + VEEZ(df) + i;
-		int rindex = result->reverse_length - i - 1 + WEDGEZ(df);
-		bool ismatch = (result->reverse[rindex].nt & result->forward[findex].nt) != '\0';
-		double fpr;
-		double rpr;
-		double q;
-		char nt;
-
-		if (index < 0 || findex < 0 || rindex < 0 || (size_t) findex >= result->forward_length || (size_t) rindex >= result->reverse_length)
-			continue;
-
-		fpr = (size_t) findex >= unmasked_forward_length ? qual_nn : qual_score[PHREDCLAMP(result->forward[findex].qual)];
-		rpr = (size_t) rindex >= unmasked_reverse_length ? qual_nn : qual_score[PHREDCLAMP(result->reverse[rindex].qual)];
-
-		if (!ismatch) {
-			LOGV(PANDA_DEBUG_MISMATCH, PANDA_CODE_MISMATCHED_BASE, "(F[%d] = %c) != (R[%d] = %c)", findex, panda_nt_to_ascii(result->forward[findex].nt), rindex, panda_nt_to_ascii(result->reverse[rindex].nt));
-			result->overlap_mismatches++;
-		}
-
-		if ((size_t) findex >= unmasked_forward_length && (size_t) rindex >= unmasked_reverse_length) {
-			q = qual_nn;
-		} else if ((size_t) findex >= unmasked_forward_length) {
-			q = rpr;
-		} else if ((size_t) rindex >= unmasked_reverse_length) {
-			q = fpr;
-		} else {
-			q = match_probability(algo_data, ismatch, result->forward[findex].qual, result->reverse[rindex].qual);
-		}
-
-		if (ismatch) {
-			nt = (result->reverse[rindex].nt & result->forward[findex].nt);
-		} else {
-			if (result->forward[findex].qual < result->reverse[rindex].qual) {
-				nt = result->reverse[rindex].nt;
-			} else {
-				nt = result->forward[findex].nt;
-			}
-		}
-		result->sequence[index].nt = nt;
-		result->sequence[index].p = q;
-		if (PANDA_NT_IS_DEGN(nt)) {
-			result->degenerates++;
-		}
-		oquality += q;
-		LOGV(PANDA_DEBUG_RECON, PANDA_CODE_BUILD_OVERLAP, "S[%d] = %c, F[%d] = %c, R[%d] = %c", index, panda_nt_to_ascii(nt), findex, panda_nt_to_ascii(result->forward[findex].nt), rindex, panda_nt_to_ascii(result->reverse[rindex].nt));
+	if (assembler->algo->clazz->match_probability_fixed) {
+		oquality = build_overlap(assembler, result, bestoverlap, df, dr, unmasked_forward_length, unmasked_reverse_length, sequence, compact, assembler->match_table);
+	} else {
+		oquality = build_overlap(assembler, result, bestoverlap, df, dr, unmasked_forward_length, unmasked_reverse_length, sequence, compact, NULL);
 	}
 
 	/* Copy the unpaired reverse sequence. */
 	for (i = 0; i < (size_t) VEEZ(dr); i++) {
 		int index = df + bestoverlap + i;
 		int rindex = result->reverse_length - bestoverlap - i - 1;
-		panda_nt rbits = result->reverse[rindex].nt;
-		double q = qual_score[PHREDCLAMP(result->reverse[rindex].qual)];
+		panda_nt rbits = assembler->reverse_arrays.nt[rindex];
+		double q = qual_score[PHREDCLAMP(assembler->reverse_arrays.qual[rindex])];
 		rquality += q;
-		result->sequence[index].nt = rbits;
-		result->sequence[index].p = q;
+		STORE_BASE(sequence, compact, index, rbits, q, assembler->score_phred[PHREDCLAMP(assembler->reverse_arrays.qual[rindex])]);
 		if (PANDA_NT_IS_DEGN(rbits)) {
 			result->degenerates++;
 		}
-		LOGV(PANDA_DEBUG_RECON, PANDA_CODE_BUILD_REVERSE, "S[%d] = R[%d] = %c", index, rindex, panda_nt_to_ascii(result->sequence[index].nt));
+		LOGV(PANDA_DEBUG_RECON, PANDA_CODE_BUILD_REVERSE, "S[%d] = R[%d] = %c", index, rindex, panda_nt_to_ascii(rbits));
 	}
 	result->quality = (fquality + rquality + oquality) / len;
 
 	result->overlap = bestoverlap;
 	result->estimated_overlap_probability = bestprobability;
 
-	return true;
+	return PANDA_REJECT_NONE;
 }
 
-bool assemble_seq(
-	PandaAssembler assembler) {
+/* Record the offset at which a primer was found, keeping the most common offsets in order. */
+static void count_primer_offset(
+	PandaAssembler assembler,
+	bool reverse,
+	size_t offset) {
+	long *counts = assembler->primer_offsetcount[reverse];
+	size_t *common = assembler->primer_offset_common[reverse];
+	size_t it;
+	if (offset > 2 * MAX_LEN) {
+		return;
+	}
+	counts[offset]++;
+	if (assembler->longest_primer_offset[reverse] < offset) {
+		assembler->longest_primer_offset[reverse] = offset;
+	}
+	/* Since counts only go up by one, an offset that is not in the list can only join it by taking the last place. Empty places hold 0, which is never counted. */
+	for (it = 0; it < PRIMER_EXPECTED_MAX - 1 && common[it] != offset; it++) ;
+	if (common[it] != offset) {
+		if (counts[common[it]] >= counts[offset]) {
+			return;
+		}
+		common[it] = offset;
+	}
+	for (; it > 0 && counts[common[it - 1]] < counts[offset]; it--) {
+		common[it] = common[it - 1];
+		common[it - 1] = offset;
+	}
+}
+
+/*
+ * Find the forward or reverse primer: at the start of its read or, if stripping primers after assembly, at its end of the assembled sequence. Returns 0 if the primer is not found, or one more than the number of bases to strip.
+ *
+ * If there is a set of primers, the sequence is only prepared once and the primer that matches best is used. Its name is stored in name.
+ */
+static size_t find_primer(
+	PandaAssembler assembler,
+	panda_result_seq *result,
+	bool reverse,
+	const char **name) {
+	const panda_primer *primers = reverse ? assembler->reverse_primers : assembler->forward_primers;
+	size_t primers_length = reverse ? assembler->reverse_primers_length : assembler->forward_primers_length;
+	size_t offset = 0;
+	*name = NULL;
+	if (primers_length == 0) {
+		if (assembler->post_primers) {
+			offset = panda_compute_offset_result_expected(assembler->threshold, assembler->primer_penalty, reverse, result->sequence, result->sequence_length, reverse ? assembler->reverse_primer : assembler->forward_primer, reverse ? assembler->reverse_primer_length : assembler->forward_primer_length, assembler->primer_offset_common[reverse], assembler->primer_expected);
+		} else {
+			offset = panda_compute_offset_qual_expected(assembler->threshold, assembler->primer_penalty, false, reverse ? result->reverse : result->forward, reverse ? result->reverse_length : result->forward_length, reverse ? assembler->reverse_primer : assembler->forward_primer, reverse ? assembler->reverse_primer_length : assembler->forward_primer_length, assembler->primer_offset_common[reverse], assembler->primer_expected);
+		}
+	} else {
+		double best_probability = -INFINITY;
+		size_t expected;
+		size_t it;
+		if (assembler->post_primers) {
+			offset_seq_prepare_result(&assembler->primer_seq, reverse, result->sequence, result->sequence_length);
+		} else {
+			offset_seq_prepare_qual(&assembler->primer_seq, false, reverse ? result->reverse : result->forward, reverse ? result->reverse_length : result->forward_length);
+		}
+		/* Check the common offsets first, as for a single primer, using the best primer at the first offset where any is good enough. */
+		for (expected = 0; expected < assembler->primer_expected && offset == 0; expected++) {
+			double expected_probability = exp(assembler->threshold);
+			for (it = 0; it < primers_length; it++) {
+				double probability = offset_seq_expected(&assembler->primer_seq, assembler->primer_penalty, primers[it].sequence, primers[it].sequence_length, assembler->primer_offset_common[reverse][expected]);
+				if (probability > expected_probability) {
+					expected_probability = probability;
+					offset = assembler->primer_offset_common[reverse][expected];
+					*name = primers[it].name;
+				}
+			}
+		}
+		if (offset == 0) {
+			for (it = 0; it < primers_length; it++) {
+				/* Only a primer that matches better than the best so far will be found, so the first of equally good primers is used. */
+				size_t primer_offset = offset_seq_find(&assembler->primer_seq, assembler->threshold, assembler->primer_penalty, primers[it].sequence, primers[it].sequence_length, &best_probability);
+				if (primer_offset > 0) {
+					offset = primer_offset;
+					*name = primers[it].name;
+				}
+			}
+		}
+	}
+	if (offset > 0) {
+		count_primer_offset(assembler, reverse, offset);
+	}
+	return offset;
+}
+
+/* Assemble the read pair in the result and decide whether to keep it. */
+static PandaReject assemble_seq(
+	PandaAssembler assembler,
+	panda_result_seq *result) {
+	PandaReject reject;
 	assembler->count++;
-	if (assembler->result.forward_length < 2 || assembler->result.reverse_length < 2) {
+	result->forward_primer_name = NULL;
+	result->reverse_primer_name = NULL;
+	/* Go back to the start of the space the previous sequence skipped its forward primer in. */
+	if (result->sequence != NULL) {
+		result->sequence -= result->sequence_offset;
+	}
+	if (result->compact != NULL) {
+		result->compact -= result->sequence_offset;
+	}
+	result->sequence_offset = 0;
+	if (result->forward_length < 2 || result->reverse_length < 2) {
 		assembler->badreadcount++;
-		return false;
+		return PANDA_REJECT_BAD_READ;
 	}
-	if (!module_precheckseq(assembler, &assembler->result.name, assembler->result.forward, assembler->result.forward_length, assembler->result.reverse, assembler->result.reverse_length)) {
-		return false;
+	if (!module_precheckseq(assembler, &result->name, result->forward, result->forward_length, result->reverse, result->reverse_length)) {
+		return PANDA_REJECT_MODULE;
 	}
 	if (!assembler->post_primers) {
-		if (assembler->forward_primer_length > 0) {
-			assembler->result.forward_offset = panda_compute_offset_qual(assembler->threshold, assembler->primer_penalty, false, assembler->result.forward, assembler->result.forward_length, assembler->forward_primer, assembler->forward_primer_length);
-			if (assembler->result.forward_offset == 0) {
+		if (assembler->forward_primer_length > 0 || assembler->forward_primers_length > 0) {
+			result->forward_offset = find_primer(assembler, result, false, &result->forward_primer_name);
+			if (result->forward_offset == 0) {
 				LOG(PANDA_DEBUG_STAT, PANDA_CODE_NO_FORWARD_PRIMER);
 				assembler->nofpcount++;
-				return false;
+				return PANDA_REJECT_NO_FORWARD_PRIMER;
 			}
-			assembler->result.forward_offset--;
+			result->forward_offset--;
 		} else {
-			assembler->result.forward_offset = assembler->forward_trim;
+			result->forward_offset = assembler->forward_trim;
 		}
-		if (assembler->reverse_primer_length > 0) {
-			assembler->result.reverse_offset = panda_compute_offset_qual(assembler->threshold, assembler->primer_penalty, false, assembler->result.reverse, assembler->result.reverse_length, assembler->reverse_primer, assembler->reverse_primer_length);
-			if (assembler->result.reverse_offset == 0) {
+		if (assembler->reverse_primer_length > 0 || assembler->reverse_primers_length > 0) {
+			result->reverse_offset = find_primer(assembler, result, true, &result->reverse_primer_name);
+			if (result->reverse_offset == 0) {
 				LOG(PANDA_DEBUG_STAT, PANDA_CODE_NO_REVERSE_PRIMER);
 				assembler->norpcount++;
-				return false;
+				return PANDA_REJECT_NO_REVERSE_PRIMER;
 			}
-			assembler->result.reverse_offset--;
+			result->reverse_offset--;
 		} else {
-			assembler->result.reverse_offset = assembler->reverse_trim;
+			result->reverse_offset = assembler->reverse_trim;
 		}
 	} else {
-		assembler->result.forward_offset = 0;
-		assembler->result.reverse_offset = 0;
+		result->forward_offset = 0;
+		result->reverse_offset = 0;
 	}
-	if (((assembler->result.forward_length < assembler->result.reverse_length) ? assembler->result.forward_length : assembler->result.reverse_length) < assembler->minoverlap) {
+	if (((result->forward_length < result->reverse_length) ? result->forward_length : result->reverse_length) < assembler->minoverlap) {
 		assembler->badreadcount++;
-		return false;
+		return PANDA_REJECT_BAD_READ;
 	}
-	if (!align(assembler, &assembler->result)) {
+	reject = align(assembler, result);
+	if (reject != PANDA_REJECT_NONE) {
+		if (reject != PANDA_REJECT_NO_ALIGNMENT) {
+			return reject;
+		}
 		if (assembler->noalgn != NULL) {
-			assembler->noalgn(assembler, &assembler->result.name, assembler->result.forward, assembler->result.forward_length, assembler->result.reverse, assembler->result.reverse_length, assembler->noalgn_data);
+			assembler->noalgn(assembler, &result->name, result->forward, result->forward_length, result->reverse, result->reverse_length, assembler->noalgn_data);
 		}
 		assembler->noalgncount++;
-		return false;
+		return PANDA_REJECT_NO_ALIGNMENT;
 	}
 	if (assembler->post_primers) {
-		size_t it;
-		if (assembler->forward_primer_length > 0) {
-			assembler->result.forward_offset = panda_compute_offset_result(assembler->threshold, assembler->primer_penalty, false, assembler->result.sequence, assembler->result.sequence_length, assembler->forward_primer, assembler->forward_primer_length);
-			if (assembler->result.forward_offset == 0) {
+		if (assembler->forward_primer_length > 0 || assembler->forward_primers_length > 0) {
+			result->forward_offset = find_primer(assembler, result, false, &result->forward_primer_name);
+			if (result->forward_offset == 0) {
 				LOG(PANDA_DEBUG_STAT, PANDA_CODE_NO_FORWARD_PRIMER);
 				assembler->nofpcount++;
-				return false;
+				return PANDA_REJECT_NO_FORWARD_PRIMER;
 			}
-			assembler->result.forward_offset--;
+			result->forward_offset--;
 		} else {
-			assembler->result.forward_offset = assembler->forward_trim;
+			result->forward_offset = assembler->forward_trim;
 		}
-		if (assembler->reverse_primer_length > 0) {
-			assembler->result.reverse_offset = panda_compute_offset_result(assembler->threshold, assembler->primer_penalty, true, assembler->result.sequence, assembler->result.sequence_length, assembler->reverse_primer, assembler->reverse_primer_length);
-			if (assembler->result.reverse_offset == 0) {
+		if (assembler->reverse_primer_length > 0 || assembler->reverse_primers_length > 0) {
+			result->reverse_offset = find_primer(assembler, result, true, &result->reverse_primer_name);
+			if (result->reverse_offset == 0) {
 				LOG(PANDA_DEBUG_STAT, PANDA_CODE_NO_REVERSE_PRIMER);
 				assembler->norpcount++;
-				return false;
+				return PANDA_REJECT_NO_REVERSE_PRIMER;
 			}
-			assembler->result.reverse_offset--;
+			result->reverse_offset--;
 		} else {
-			assembler->result.reverse_offset = assembler->reverse_trim;
+			result->reverse_offset = assembler->reverse_trim;
 		}
-		if (assembler->result.sequence_length <= assembler->result.forward_offset + assembler->result.reverse_offset) {
+		if (result->sequence_length <= result->forward_offset + result->reverse_offset) {
 			LOG(PANDA_DEBUG_STAT, PANDA_CODE_NO_FORWARD_PRIMER);
 			assembler->nofpcount++;
-			return false;
+			return PANDA_REJECT_NO_FORWARD_PRIMER;
 		}
-		assembler->result.sequence_length -= assembler->result.forward_offset + assembler->result.reverse_offset;
-		for (it = 0; it < assembler->result.sequence_length; it++) {
-			assembler->result.sequence[it] = assembler->result.sequence[it + assembler->result.forward_offset];
+		/* Skip the primers rather than moving the rest of the sequence over them. */
+		result->sequence_length -= result->forward_offset + result->reverse_offset;
+		result->sequence_offset = result->forward_offset;
+		result->sequence += result->sequence_offset;
+		if (result->compact != NULL) {
+			result->compact += result->sequence_offset;
 		}
 	}
-	if (assembler->result.quality < assembler->threshold) {
+	if (result->quality < assembler->threshold) {
 		assembler->lowqcount++;
-		LOGV(PANDA_DEBUG_STAT, PANDA_CODE_LOW_QUALITY_REJECT, "%f < %f", exp(assembler->result.quality), exp(assembler->threshold));
-		return false;
+		LOGV(PANDA_DEBUG_STAT, PANDA_CODE_LOW_QUALITY_REJECT, "%f < %f", exp(result->quality), exp(assembler->threshold));
+		return PANDA_REJECT_LOW_QUALITY;
 	}
-	if (module_checkseq(assembler, &assembler->result)) {
+	if (module_checkseq(assembler, result)) {
 		assembler->okcount++;
-		assembler->overlapcount[assembler->result.overlap]++;
-		if (assembler->longest_overlap < assembler->result.overlap) {
-			assembler->longest_overlap = assembler->result.overlap;
+		assembler->overlapcount[result->overlap]++;
+		if (assembler->overlapcount[result->overlap] > assembler->overlapcount[assembler->overlap_mode]) {
+			assembler->overlap_mode = result->overlap;
+		}
+		if (assembler->longest_overlap < result->overlap) {
+			assembler->longest_overlap = result->overlap;
 		}
-		return true;
+		return PANDA_REJECT_NONE;
+	}
+	return PANDA_REJECT_MODULE;
+}
+
+/* Assemble read pairs into results that already have space for their sequences. */
+static size_t assemble_pairs(
+	PandaAssembler assembler,
+	const panda_read_pair *pairs,
+	size_t pairs_length,
+	panda_result_seq *results,
+	PandaReject *rejects) {
+	size_t assembled = 0;
+	size_t it;
+	for (it = 0; it < pairs_length; it++) {
+		PandaReject reject;
+		assert(pairs[it].forward_length <= PANDA_MAX_LEN);
+		assert(pairs[it].reverse_length <= PANDA_MAX_LEN);
+		if (&results[it].name != pairs[it].name) {
+			results[it].name = *pairs[it].name;
+		}
+		results[it].forward = pairs[it].forward;
+		results[it].forward_length = pairs[it].forward_length;
+		results[it].reverse = pairs[it].reverse;
+		results[it].reverse_length = pairs[it].reverse_length;
+		reject = assemble_seq(assembler, &results[it]);
+		if (reject == PANDA_REJECT_NONE) {
+			assembled++;
+		}
+		if (rejects != NULL) {
+			rejects[it] = reject;
+		}
+	}
+	return assembled;
+}
+
+/* Point a result at the forms of the sequence the assembler is producing. */
+static void use_result_storage(
+	PandaAssembler assembler,
+	panda_result_seq *result,
+	panda_result *sequence,
+	panda_result_compact *compact) {
+	result->sequence = assembler_needs_probabilities(assembler) ? sequence : NULL;
+	result->compact = assembler->compact_results ? compact : NULL;
+	result->sequence_offset = 0;
+}
+
+size_t panda_assembler_assemble_batch(
+	PandaAssembler assembler,
+	const panda_read_pair *pairs,
+	size_t pairs_length,
+	panda_result_seq *results,
+	PandaReject *rejects) {
+	size_t it;
+	if (pairs_length > assembler->batch_size) {
+		assembler->batch_seq = realloc(assembler->batch_seq, pairs_length * 2 * PANDA_MAX_LEN * sizeof(panda_result));
+		assembler->batch_compact = realloc(assembler->batch_compact, pairs_length * 2 * PANDA_MAX_LEN * sizeof(panda_result_compact));
+		assembler->batch_size = pairs_length;
+	}
+	for (it = 0; it < pairs_length; it++) {
+		use_result_storage(assembler, &results[it], assembler->batch_seq + it * 2 * PANDA_MAX_LEN, assembler->batch_compact + it * 2 * PANDA_MAX_LEN);
 	}
-	return false;
+	return assemble_pairs(assembler, pairs, pairs_length, results, rejects);
 }
 
 const panda_result_seq *panda_assembler_next(
 	PandaAssembler assembler) {
+	panda_read_pair pair;
 	if (assembler->next == NULL) {
 		return NULL;
 	}
+	pair.name = &assembler->result.name;
+	use_result_storage(assembler, &assembler->result, assembler->result_seq, assembler->result_compact);
 	while (true) {
-		if (!assembler->next(&assembler->result.name, &assembler->result.forward, &assembler->result.forward_length, &assembler->result.reverse, &assembler->result.reverse_length, assembler->next_data)) {
+		if (!assembler->next(&assembler->result.name, &pair.forward, &pair.forward_length, &pair.reverse, &pair.reverse_length, assembler->next_data)) {
 			return NULL;
 		}
-		assert(assembler->result.forward_length <= PANDA_MAX_LEN);
-		assert(assembler->result.reverse_length <= PANDA_MAX_LEN);
-		if (assemble_seq(assembler)) {
+		if (assemble_pairs(assembler, &pair, 1, &assembler->result, NULL) > 0) {
 			return &assembler->result;
 		}
 	}
@@ -372,12 +856,12 @@ const panda_result_seq *panda_assembler_assemble(
 	size_t forward_length,
 	const panda_qual *reverse,
 	size_t reverse_length) {
-	assert(forward_length <= PANDA_MAX_LEN);
-	assert(reverse_length <= PANDA_MAX_LEN);
-	assembler->result.name = *id;
-	assembler->result.forward_length = forward_length;
-	assembler->result.reverse_length = reverse_length;
-	assembler->result.forward = forward;
-	assembler->result.reverse = reverse;
-	return assemble_seq(assembler) ? &assembler->result : NULL;
+	panda_read_pair pair;
+	pair.name = id;
+	pair.forward = forward;
+	pair.forward_length = forward_length;
+	pair.reverse = reverse;
+	pair.reverse_length = reverse_length;
+	use_result_storage(assembler, &assembler->result, assembler->result_seq, assembler->result_compact);
+	return assemble_pairs(assembler, &pair, 1, &assembler->result, NULL) > 0 ? &assembler->result : NULL;
 }
@@ -20,11 +20,19 @@
 #        define ASM_H
 #        include "config.h"
 #        include "pandaseq.h"
+#        include "kernel.h"
+#        include "kmerindex.h"
 #        include "misc.h"
+#        include "offset.h"
+#        include "packed.h"
+#        include "prob.h"
 #        ifdef HAVE_PTHREAD
 #                include <pthread.h>
 #        endif
 
+/* The most primer offsets that can be checked before searching the whole sequence. */
+#        define PRIMER_EXPECTED_MAX 16
+
 struct panda_assembler {
 	volatile size_t refcnt;
 
@@ -40,19 +48,41 @@ struct panda_assembler {
 	PandaModule *modules;
 	size_t modules_length;
 	size_t modules_size;
+	/* The number of modules that read the log probabilities of assembled sequences. */
+	size_t sequence_modules;
 
 	double threshold;
 	size_t minoverlap;
 	size_t maxoverlap;
 
-	seqindex *kmerseen;
+	kmer_index kmers;
 	size_t num_kmers;
+	size_t kmer_length;
+	PandaSeedPolicy seed_policy;
+	size_t overlap_warmup;
 	PandaAlgorithm algo;
+	/* The algorithm's match probability, by whether the bases match and their PHRED scores. Only used if the algorithm class says it never changes. */
+	double match_table[2][PHREDMAX + 1][PHREDMAX + 1];
+	/* The PHRED scores of the entries in the match table, of each quality score, and of an unpaired base, for compact results. */
+	char match_phred[2][PHREDMAX + 1][PHREDMAX + 1];
+	char score_phred[PHREDMAX + 1];
+	char unpaired_phred;
 
 	panda_result_seq result;
+	/* Space for the sequences of the results of panda_assembler_assemble_batch, for as many results as the largest batch so far. */
+	panda_result *batch_seq;
+	panda_result_compact *batch_compact;
+	size_t batch_size;
 
 	size_t forward_primer_length;
 	size_t reverse_primer_length;
+	/* The named primers to choose between, if there are any, instead of the single primers. */
+	panda_primer *forward_primers;
+	size_t forward_primers_length;
+	size_t forward_primers_size;
+	panda_primer *reverse_primers;
+	size_t reverse_primers_length;
+	size_t reverse_primers_size;
 	size_t forward_trim;
 	size_t reverse_trim;
 
@@ -64,18 +94,46 @@ struct panda_assembler {
 	long noalgncount;
 	long badreadcount;
 	long slowcount;
+	long seedcount[PANDA_SEED_ALL + 1];
+	long priorcount;
 	long count;
 	bool post_primers;
+	bool compact_results;
 #        ifdef HAVE_PTHREAD
 	pthread_mutex_t mutex;
 #        endif
 	panda_nt forward_primer[MAX_LEN];
 	panda_nt reverse_primer[MAX_LEN];
 	panda_result result_seq[2 * MAX_LEN];
+	panda_result_compact result_compact[2 * MAX_LEN];
 	long overlapcount[2 * MAX_LEN];
 	size_t longest_overlap;
+	size_t overlap_mode;
 	char name[MAX_LEN];
 	double primer_penalty;
+	/* How many of the most common primer offsets to check first. */
+	size_t primer_expected;
+	/* How often each offset has been chosen for the forward and reverse primers, the largest so far, and the most common ones, most common first. */
+	long primer_offsetcount[2][2 * MAX_LEN + 1];
+	size_t longest_primer_offset[2];
+	size_t primer_offset_common[2][PRIMER_EXPECTED_MAX];
+	packed_seq forward_packed;
+	packed_seq reverse_packed;
+	/* The reads being assembled, separated once so the per-base loops read contiguous nucleotides and scores. */
+	read_arrays forward_arrays;
+	read_arrays reverse_arrays;
+	/* The reads decoded for the algorithm's overlap table, if it has one. */
+	overlap_reads overlap_reads;
+	/* The sequence being searched for a set of primers, prepared once for all of them. */
+	offset_seq primer_seq;
 };
 
+/* Whether the assembler must fill in the log probabilities of the sequences it assembles, rather than only the compact results. */
+bool assembler_needs_probabilities(
+	PandaAssembler assembler);
+
+/* Tabulate the scores the assembler's algorithm gives the bases in the overlap and their PHRED scores. This must be called whenever the algorithm changes. */
+void assembler_prepare_algorithm(
+	PandaAssembler assembler);
+
 #endif
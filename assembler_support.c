@@ -24,6 +24,40 @@
 #include "assembler.h"
 #include "module.h"
 
+static void clear_primers(
+	panda_primer **primers,
+	size_t *length,
+	size_t *size) {
+	size_t it;
+	for (it = 0; it < *length; it++) {
+		free((*primers)[it].name);
+		free((*primers)[it].sequence);
+	}
+	free(*primers);
+	*primers = NULL;
+	*length = 0;
+	*size = 0;
+}
+
+static void add_primer(
+	panda_primer **primers,
+	size_t *length,
+	size_t *size,
+	const char *name,
+	const panda_nt *sequence,
+	size_t sequence_length) {
+	if (*length == *size) {
+		*size = (*size == 0) ? 8 : (*size * 2);
+		*primers = realloc(*primers, *size * sizeof(panda_primer));
+	}
+	(*primers)[*length].name = malloc(strlen(name) + 1);
+	memcpy((*primers)[*length].name, name, strlen(name) + 1);
+	(*primers)[*length].sequence = malloc(sequence_length * sizeof(panda_nt));
+	memcpy((*primers)[*length].sequence, sequence, sequence_length * sizeof(panda_nt));
+	(*primers)[*length].sequence_length = sequence_length;
+	(*length)++;
+}
+
 PandaAssembler panda_assembler_new(
 	PandaNextSeq next,
 	void *next_data,
@@ -56,12 +90,24 @@ PandaAssembler panda_assembler_new_kmer(
 	assembler->rejected = NULL;
 	assembler->modules = NULL;
 	assembler->modules_length = 0;
+	assembler->sequence_modules = 0;
 	assembler->modules_size = 0;
 	assembler->result.forward = NULL;
 	assembler->forward_primer_length = 0;
+	assembler->forward_primers = NULL;
+	assembler->forward_primers_length = 0;
+	assembler->forward_primers_size = 0;
 	assembler->result.reverse = NULL;
 	assembler->result.sequence = assembler->result_seq;
+	assembler->result.compact = NULL;
+	assembler->result.sequence_offset = 0;
+	assembler->batch_seq = NULL;
+	assembler->batch_compact = NULL;
+	assembler->batch_size = 0;
 	assembler->reverse_primer_length = 0;
+	assembler->reverse_primers = NULL;
+	assembler->reverse_primers_length = 0;
+	assembler->reverse_primers_size = 0;
 	assembler->forward_trim = 0;
 	assembler->reverse_trim = 0;
 	assembler->nofpcount = 0;
@@ -73,14 +119,25 @@ PandaAssembler panda_assembler_new_kmer(
 	assembler->slowcount = 0;
 	assembler->count = 0;
 	assembler->post_primers = false;
+	assembler->compact_results = false;
 	assembler->threshold = log(0.6);
 	assembler->algo = panda_algorithm_simple_bayes_new();
+	assembler_prepare_algorithm(assembler);
 	memset(assembler->overlapcount, 0, 2 * PANDA_MAX_LEN * sizeof(long));
 	assembler->longest_overlap = 0;
+	assembler->overlap_mode = 0;
+	assembler->overlap_warmup = 0;
+	assembler->primer_expected = 0;
+	memset(assembler->primer_offsetcount, 0, sizeof(assembler->primer_offsetcount));
+	memset(assembler->longest_primer_offset, 0, sizeof(assembler->longest_primer_offset));
+	memset(assembler->primer_offset_common, 0, sizeof(assembler->primer_offset_common));
+	assembler->priorcount = 0;
 	assembler->num_kmers = num_kmers;
+	assembler->kmer_length = PANDA_DEFAULT_KMER_LENGTH;
+	assembler->seed_policy = PANDA_SEED_POLICY_DEFAULT;
+	memset(assembler->seedcount, 0, sizeof(assembler->seedcount));
 	assert(1 << (8 * sizeof(seqindex)) > PANDA_MAX_LEN);
-	assembler->kmerseen = malloc(KMERSEEN_SIZE(num_kmers));
-	if (assembler->kmerseen == NULL) {
+	if (!kmer_index_init(&assembler->kmers, num_kmers)) {
 		if (next_destroy != NULL) {
 			next_destroy(next_data);
 		}
@@ -91,7 +148,6 @@ PandaAssembler panda_assembler_new_kmer(
 #ifdef HAVE_PTHREAD
 	pthread_mutex_init(&assembler->mutex, NULL);
 #endif
-	memset(assembler->kmerseen, 0, KMERSEEN_SIZE(num_kmers));
 	panda_assembler_set_maximum_overlap(assembler, 0);
 	panda_assembler_set_minimum_overlap(assembler, 2);
 	panda_assembler_set_primer_penalty(assembler, 0);
@@ -125,15 +181,30 @@ void panda_assembler_copy_configuration(
 	}
 	panda_assembler_set_forward_primer(dest, src->forward_primer, src->forward_primer_length);
 	panda_assembler_set_reverse_primer(dest, src->reverse_primer, src->reverse_primer_length);
+	for (it = 0; it < src->forward_primers_length; it++) {
+		panda_assembler_add_forward_primer(dest, src->forward_primers[it].name, src->forward_primers[it].sequence, src->forward_primers[it].sequence_length);
+	}
+	for (it = 0; it < src->reverse_primers_length; it++) {
+		panda_assembler_add_reverse_primer(dest, src->reverse_primers[it].name, src->reverse_primers[it].sequence, src->reverse_primers[it].sequence_length);
+	}
 	dest->forward_trim = src->forward_trim;
 	dest->reverse_trim = src->reverse_trim;
 	dest->threshold = src->threshold;
 	dest->minoverlap = src->minoverlap;
 	dest->maxoverlap = src->maxoverlap;
+	dest->kmer_length = src->kmer_length;
+	dest->seed_policy = src->seed_policy;
+	dest->overlap_warmup = src->overlap_warmup;
 	dest->post_primers = src->post_primers;
+	dest->compact_results = src->compact_results;
 	panda_algorithm_unref(dest->algo);
 	dest->algo = panda_algorithm_ref(src->algo);
+	memcpy(dest->match_table, src->match_table, sizeof(dest->match_table));
+	memcpy(dest->match_phred, src->match_phred, sizeof(dest->match_phred));
+	memcpy(dest->score_phred, src->score_phred, sizeof(dest->score_phred));
+	dest->unpaired_phred = src->unpaired_phred;
 	dest->primer_penalty = src->primer_penalty;
+	dest->primer_expected = src->primer_expected;
 }
 
 PandaAssembler panda_assembler_ref(
@@ -164,12 +235,16 @@ void panda_assembler_unref(
 #ifdef HAVE_PTHREAD
 		pthread_mutex_destroy(&assembler->mutex);
 #endif
-		free(assembler->kmerseen);
+		kmer_index_cleanup(&assembler->kmers);
 		module_destroy(assembler);
+		clear_primers(&assembler->forward_primers, &assembler->forward_primers_length, &assembler->forward_primers_size);
+		clear_primers(&assembler->reverse_primers, &assembler->reverse_primers_length, &assembler->reverse_primers_size);
 		DESTROY_MEMBER(assembler, next);
 		DESTROY_MEMBER(assembler, noalgn);
 		panda_algorithm_unref(assembler->algo);
 		panda_log_proxy_unref(assembler->logger);
+		free(assembler->batch_seq);
+		free(assembler->batch_compact);
 		free(assembler);
 	}
 }
@@ -186,6 +261,7 @@ void panda_assembler_set_algorithm(
 		return;
 	panda_algorithm_unref(assembler->algo);
 	assembler->algo = panda_algorithm_ref(algorithm);
+	assembler_prepare_algorithm(assembler);
 }
 
 long panda_assembler_get_bad_read_count(
@@ -209,6 +285,7 @@ void panda_assembler_set_forward_primer(
 		}
 		assembler->forward_primer_length = length;
 		assembler->forward_trim = 0;
+		clear_primers(&assembler->forward_primers, &assembler->forward_primers_length, &assembler->forward_primers_size);
 	}
 }
 
@@ -236,6 +313,26 @@ panda_nt *panda_assembler_get_forward_primer(
 	return assembler->forward_primer_length == 0 ? NULL : assembler->forward_primer;
 }
 
+void panda_assembler_add_forward_primer(
+	PandaAssembler assembler,
+	const char *name,
+	const panda_nt *sequence,
+	size_t length) {
+	if (length > 0 && length < PANDA_MAX_LEN) {
+		add_primer(&assembler->forward_primers, &assembler->forward_primers_length, &assembler->forward_primers_size, name, sequence, length);
+		assembler->forward_primer_length = 0;
+		assembler->forward_trim = 0;
+	}
+}
+
+const panda_primer *panda_assembler_get_forward_primers(
+	PandaAssembler assembler,
+	size_t *length) {
+	if (length != NULL)
+		*length = assembler->forward_primers_length;
+	return assembler->forward_primers_length == 0 ? NULL : assembler->forward_primers;
+}
+
 size_t panda_assembler_get_forward_trim(
 	PandaAssembler assembler) {
 	return assembler->forward_trim;
@@ -246,6 +343,7 @@ void panda_assembler_set_forward_trim(
 	size_t trim) {
 	assembler->forward_trim = trim;
 	assembler->forward_primer_length = 0;
+	clear_primers(&assembler->forward_primers, &assembler->forward_primers_length, &assembler->forward_primers_size);
 }
 
 size_t panda_assembler_get_num_kmer(
@@ -253,6 +351,52 @@ size_t panda_assembler_get_num_kmer(
 	return assembler->num_kmers;
 }
 
+size_t panda_assembler_get_kmer_length(
+	PandaAssembler assembler) {
+	return assembler->kmer_length;
+}
+
+void panda_assembler_set_kmer_length(
+	PandaAssembler assembler,
+	size_t length) {
+	if (length >= PANDA_MIN_KMER_LENGTH && length <= PANDA_MAX_KMER_LENGTH) {
+		assembler->kmer_length = length;
+	}
+}
+
+PandaSeedPolicy panda_assembler_get_seed_policy(
+	PandaAssembler assembler) {
+	return assembler->seed_policy;
+}
+
+void panda_assembler_set_seed_policy(
+	PandaAssembler assembler,
+	PandaSeedPolicy policy) {
+	assembler->seed_policy = policy;
+}
+
+long panda_assembler_get_seed_count(
+	PandaAssembler assembler,
+	PandaSeed seed) {
+	return seed <= PANDA_SEED_ALL ? assembler->seedcount[seed] : 0;
+}
+
+size_t panda_assembler_get_overlap_warmup(
+	PandaAssembler assembler) {
+	return assembler->overlap_warmup;
+}
+
+void panda_assembler_set_overlap_warmup(
+	PandaAssembler assembler,
+	size_t warmup) {
+	assembler->overlap_warmup = warmup;
+}
+
+long panda_assembler_get_prior_count(
+	PandaAssembler assembler) {
+	return assembler->priorcount;
+}
+
 size_t panda_assembler_get_longest_overlap(
 	PandaAssembler assembler) {
 	return assembler->longest_overlap;
@@ -333,6 +477,22 @@ long panda_assembler_get_overlap_count(
 	return (length < 2 * PANDA_MAX_LEN) ? assembler->overlapcount[length] : -1;
 }
 
+bool panda_assembler_get_compact_results(
+	PandaAssembler assembler) {
+	return assembler->compact_results;
+}
+
+void panda_assembler_set_compact_results(
+	PandaAssembler assembler,
+	bool compact) {
+	assembler->compact_results = compact;
+}
+
+bool assembler_needs_probabilities(
+	PandaAssembler assembler) {
+	return !assembler->compact_results || assembler->post_primers || assembler->sequence_modules > 0;
+}
+
 bool panda_assembler_get_primers_after(
 	PandaAssembler assembler) {
 	return assembler->post_primers;
@@ -355,6 +515,7 @@ void panda_assembler_set_reverse_primer(
 		}
 		assembler->reverse_primer_length = length;
 		assembler->reverse_trim = 0;
+		clear_primers(&assembler->reverse_primers, &assembler->reverse_primers_length, &assembler->reverse_primers_size);
 	}
 }
 
@@ -366,6 +527,26 @@ panda_nt *panda_assembler_get_reverse_primer(
 	return assembler->reverse_primer_length == 0 ? NULL : assembler->reverse_primer;
 }
 
+void panda_assembler_add_reverse_primer(
+	PandaAssembler assembler,
+	const char *name,
+	const panda_nt *sequence,
+	size_t length) {
+	if (length > 0 && length < PANDA_MAX_LEN) {
+		add_primer(&assembler->reverse_primers, &assembler->reverse_primers_length, &assembler->reverse_primers_size, name, sequence, length);
+		assembler->reverse_primer_length = 0;
+		assembler->reverse_trim = 0;
+	}
+}
+
+const panda_primer *panda_assembler_get_reverse_primers(
+	PandaAssembler assembler,
+	size_t *length) {
+	if (length != NULL)
+		*length = assembler->reverse_primers_length;
+	return assembler->reverse_primers_length == 0 ? NULL : assembler->reverse_primers;
+}
+
 size_t panda_assembler_get_reverse_trim(
 	PandaAssembler assembler) {
 	return assembler->reverse_trim;
@@ -376,6 +557,7 @@ void panda_assembler_set_reverse_trim(
 	size_t trim) {
 	assembler->reverse_trim = trim;
 	assembler->reverse_primer_length = 0;
+	clear_primers(&assembler->reverse_primers, &assembler->reverse_primers_length, &assembler->reverse_primers_size);
 }
 
 long panda_assembler_get_slow_count(
@@ -408,3 +590,29 @@ void panda_assembler_set_primer_penalty(
 		assembler->primer_penalty = threshold;
 	}
 }
+
+size_t panda_assembler_get_primer_expected(
+	PandaAssembler assembler) {
+	return assembler->primer_expected;
+}
+
+void panda_assembler_set_primer_expected(
+	PandaAssembler assembler,
+	size_t expected) {
+	if (expected <= PRIMER_EXPECTED_MAX) {
+		assembler->primer_expected = expected;
+	}
+}
+
+long panda_assembler_get_primer_offset_count(
+	PandaAssembler assembler,
+	bool reverse,
+	size_t offset) {
+	return (offset <= 2 * PANDA_MAX_LEN) ? assembler->primer_offsetcount[reverse][offset] : -1;
+}
+
+size_t panda_assembler_get_longest_primer_offset(
+	PandaAssembler assembler,
+	bool reverse) {
+	return assembler->longest_primer_offset[reverse];
+}
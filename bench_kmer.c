@@ -0,0 +1,182 @@
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<time.h>
+#include "config.h"
+#include "pandaseq.h"
+#include "kmerindex.h"
+#include "misc.h"
+
+/* The number of assemblers whose tables are used in turn, as threads sharing a cache would. */
+#define ASSEMBLERS 8
+#define REPEATS 9
+#define MAX_PAIRS 100000
+
+typedef struct {
+	panda_nt forward[MAX_LEN];
+	size_t forward_length;
+	panda_nt reverse[MAX_LEN];
+	size_t reverse_length;
+} read_pair;
+
+/* A table with room for the positions of every possible k-mer, which is what the assembler used before the index. A position of zero marks an empty entry. */
+typedef struct {
+	seqindex *positions;
+	size_t num_kmers;
+} kmer_table;
+
+/* Load the nucleotides of the read pairs in a pair of FASTQ files. */
+static size_t load_pairs(
+	const char *forward,
+	const char *reverse,
+	PandaLogProxy logger,
+	read_pair *pairs) {
+	void *next_data;
+	PandaDestroy next_destroy;
+	PandaNextSeq next = panda_open_fastq(forward, reverse, logger, 33, PANDA_TAG_OPTIONAL, NULL, &next_data, &next_destroy);
+	panda_seq_identifier id;
+	const panda_qual *forward_read;
+	const panda_qual *reverse_read;
+	size_t pairs_length = 0;
+	size_t it;
+	if (next == NULL) {
+		return 0;
+	}
+	while (pairs_length < MAX_PAIRS && next(&id, &forward_read, &pairs[pairs_length].forward_length, &reverse_read, &pairs[pairs_length].reverse_length, next_data)) {
+		for (it = 0; it < pairs[pairs_length].forward_length; it++) {
+			pairs[pairs_length].forward[it] = forward_read[it].nt;
+		}
+		for (it = 0; it < pairs[pairs_length].reverse_length; it++) {
+			pairs[pairs_length].reverse[it] = reverse_read[it].nt;
+		}
+		pairs_length++;
+	}
+	if (next_destroy != NULL) {
+		next_destroy(next_data);
+	}
+	return pairs_length;
+}
+
+/* Find the shared k-mers of a read pair using a table of every k-mer, clearing it again afterwards. */
+static size_t seed_table(
+	kmer_table *table,
+	const read_pair *pair) {
+	kmer_it it;
+	size_t found = 0;
+	size_t j;
+	_FOREACH_KMER(it, pair->forward,, 0, KMER_LEN, < (ptrdiff_t) pair->forward_length, ++, KMER_LEN) {
+		for (j = 0; j < table->num_kmers && table->positions[KMER(it) * table->num_kmers + j] != 0; j++) ;
+		if (j < table->num_kmers) {
+			table->positions[KMER(it) * table->num_kmers + j] = KMER_POSITION(it);
+		}
+	}
+	_FOREACH_KMER(it, pair->reverse,, pair->reverse_length - 1, KMER_LEN, >= 0, --, KMER_LEN) {
+		for (j = 0; j < table->num_kmers && table->positions[KMER(it) * table->num_kmers + j] != 0; j++) {
+			found += table->positions[KMER(it) * table->num_kmers + j];
+		}
+	}
+	_FOREACH_KMER(it, pair->forward,, 0, KMER_LEN, < (ptrdiff_t) pair->forward_length, ++, KMER_LEN) {
+		for (j = 0; j < table->num_kmers; j++) {
+			table->positions[KMER(it) * table->num_kmers + j] = 0;
+		}
+	}
+	return found;
+}
+
+/* Find the shared k-mers of a read pair using the index, as the assembler does. */
+static size_t seed_index(
+	kmer_index *index,
+	const read_pair *pair) {
+	kmer_it it;
+	size_t found = 0;
+	size_t j;
+	kmer_index_reset(index, pair->forward_length);
+	_FOREACH_KMER(it, pair->forward,, 0, KMER_LEN, < (ptrdiff_t) pair->forward_length, ++, KMER_LEN) {
+		kmer_index_add(index, KMER(it), KMER_POSITION(it));
+	}
+	_FOREACH_KMER(it, pair->reverse,, pair->reverse_length - 1, KMER_LEN, >= 0, --, KMER_LEN) {
+		const seqindex *positions;
+		size_t positions_length = kmer_index_find(index, KMER(it), &positions);
+		for (j = 0; j < positions_length; j++) {
+			found += positions[j];
+		}
+	}
+	return found;
+}
+
+/* Report the best time of several runs per read pair, using the processor time, since only seeding is of interest. */
+static void report(
+	const char *name,
+	size_t bytes,
+	size_t pairs_length,
+	double best,
+	size_t found) {
+	printf("%s\t%zd bytes per assembler\t%zd pairs\t%.3f us/pair\t%zd found\n", name, bytes, pairs_length, best / pairs_length * 1e6, found);
+}
+
+int main(
+	int argc,
+	char **argv) {
+	PandaWriter writer;
+	PandaLogProxy logger;
+	read_pair *pairs;
+	size_t pairs_length;
+	kmer_table tables[ASSEMBLERS];
+	kmer_index indices[ASSEMBLERS];
+	size_t table_size = ((size_t) 1 << (2 * KMER_LEN)) * PANDA_DEFAULT_NUM_KMERS;
+	double best_table = -1;
+	double best_index = -1;
+	size_t found_table = 0;
+	size_t found_index = 0;
+	size_t repeat;
+	size_t it;
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s forward.fastq reverse.fastq\nMeasures how quickly the shared k-mers of the read pairs are found using a table of every k-mer and using the per-read index, with %d assemblers taking turns.\n", argv[0], ASSEMBLERS);
+		return 1;
+	}
+	writer = panda_writer_new_stderr();
+	logger = panda_log_proxy_new(writer);
+	pairs = malloc(MAX_PAIRS * sizeof(read_pair));
+	pairs_length = load_pairs(argv[1], argv[2], logger, pairs);
+	panda_log_proxy_unref(logger);
+	panda_writer_unref(writer);
+	if (pairs_length == 0) {
+		free(pairs);
+		return 1;
+	}
+	for (it = 0; it < ASSEMBLERS; it++) {
+		tables[it].positions = calloc(table_size, sizeof(seqindex));
+		tables[it].num_kmers = PANDA_DEFAULT_NUM_KMERS;
+		kmer_index_init(&indices[it], PANDA_DEFAULT_NUM_KMERS);
+	}
+	for (repeat = 0; repeat < REPEATS; repeat++) {
+		clock_t start;
+		double seconds;
+		found_table = 0;
+		start = clock();
+		for (it = 0; it < pairs_length; it++) {
+			found_table += seed_table(&tables[it % ASSEMBLERS], &pairs[it]);
+		}
+		seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+		if (best_table < 0 || seconds < best_table) {
+			best_table = seconds;
+		}
+		found_index = 0;
+		start = clock();
+		for (it = 0; it < pairs_length; it++) {
+			found_index += seed_index(&indices[it % ASSEMBLERS], &pairs[it]);
+		}
+		seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+		if (best_index < 0 || seconds < best_index) {
+			best_index = seconds;
+		}
+	}
+	report("table", table_size * sizeof(seqindex), pairs_length, best_table, found_table);
+	report("index", indices[0].capacity * (sizeof(uint64_t) + (1 + indices[0].num_kmers) * sizeof(seqindex)), pairs_length, best_index, found_index);
+	for (it = 0; it < ASSEMBLERS; it++) {
+		free(tables[it].positions);
+		kmer_index_cleanup(&indices[it]);
+	}
+	free(pairs);
+	return 0;
+}
@@ -0,0 +1,93 @@
+#include<stdio.h>
+#include<stdlib.h>
+#include<time.h>
+#include "config.h"
+#include "pandaseq.h"
+
+/* Report the rate data was processed, using the processor time, since only parsing is of interest. */
+static void report(
+	const char *name,
+	size_t bytes,
+	long items,
+	const char *item_name,
+	clock_t start) {
+	double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+	printf("%s\t%zd bytes\t%ld %s\t%.3f s\t%.1f MB/s\n", name, bytes, items, item_name, seconds, seconds > 0 ? bytes / seconds / 1e6 : 0);
+}
+
+/* Split a file into lines, counting the bytes in them. */
+static bool bench_lines(
+	const char *filename,
+	PandaLogProxy logger,
+	size_t *bytes) {
+	void *read_data;
+	PandaDestroy read_destroy;
+	PandaBufferRead read = panda_open_buffer(filename, logger, &read_data, &read_destroy);
+	PandaLineBuf linebuf;
+	size_t length;
+	long lines = 0;
+	clock_t start;
+	if (read == NULL) {
+		return false;
+	}
+	linebuf = panda_linebuf_new(read, read_data, read_destroy);
+	*bytes = 0;
+	start = clock();
+	while (panda_linebuf_next_length(linebuf, &length) != NULL) {
+		*bytes += length + 1;
+		lines++;
+	}
+	report("lines", *bytes, lines, "lines", start);
+	panda_linebuf_free(linebuf);
+	return true;
+}
+
+/* Parse a pair of FASTQ files into reads. */
+static bool bench_fastq(
+	const char *forward,
+	const char *reverse,
+	PandaLogProxy logger,
+	size_t bytes) {
+	void *next_data;
+	PandaDestroy next_destroy;
+	PandaNextSeq next = panda_open_fastq(forward, reverse, logger, 33, PANDA_TAG_OPTIONAL, NULL, &next_data, &next_destroy);
+	panda_seq_identifier id;
+	const panda_qual *forward_read;
+	size_t forward_length;
+	const panda_qual *reverse_read;
+	size_t reverse_length;
+	long pairs = 0;
+	clock_t start;
+	if (next == NULL) {
+		return false;
+	}
+	start = clock();
+	while (next(&id, &forward_read, &forward_length, &reverse_read, &reverse_length, next_data)) {
+		pairs++;
+	}
+	report("fastq", bytes, pairs, "pairs", start);
+	if (next_destroy != NULL) {
+		next_destroy(next_data);
+	}
+	return true;
+}
+
+int main(
+	int argc,
+	char **argv) {
+	PandaWriter writer;
+	PandaLogProxy logger;
+	size_t forward_bytes;
+	size_t reverse_bytes;
+	bool ok;
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s forward.fastq reverse.fastq\nMeasures how quickly the files can be split into lines and parsed as FASTQ read pairs.\n", argv[0]);
+		return 1;
+	}
+	writer = panda_writer_new_stderr();
+	logger = panda_log_proxy_new(writer);
+	ok = bench_lines(argv[1], logger, &forward_bytes) && bench_lines(argv[2], logger, &reverse_bytes) && bench_fastq(argv[1], argv[2], logger, forward_bytes + reverse_bytes);
+	panda_log_proxy_unref(logger);
+	panda_writer_unref(writer);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include<stdbool.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include "config.h"
+#include "pandaseq.h"
+
+#define PAIRS 20
+#define READ_LENGTH 150
+
+static const panda_nt nucleotides[] = { PANDA_NT_A, PANDA_NT_C, PANDA_NT_G, PANDA_NT_T };
+
+/* Make a pair of reads that overlap by the requested amount, with good scores, so most of them assemble. */
+static void overlapping_reads(
+	panda_qual *forward,
+	panda_qual *reverse,
+	size_t overlap) {
+	size_t it;
+	for (it = 0; it < READ_LENGTH; it++) {
+		forward[it].nt = nucleotides[rand() % 4];
+		forward[it].qual = rand() % 10 + 30;
+		reverse[it].nt = nucleotides[rand() % 4];
+		reverse[it].qual = rand() % 10 + 30;
+	}
+	for (it = 0; it < overlap; it++) {
+		reverse[READ_LENGTH - it - 1].nt = forward[READ_LENGTH - overlap + it].nt;
+	}
+}
+
+/* Check that a result from a batch matches the one from assembling the same read pair alone. */
+static bool same_result(
+	const panda_result_seq *expected,
+	const panda_result_seq *actual) {
+	size_t it;
+	if (expected->sequence_length != actual->sequence_length || expected->quality != actual->quality || expected->overlap != actual->overlap) {
+		return false;
+	}
+	if ((expected->sequence == NULL) != (actual->sequence == NULL) || (expected->compact == NULL) != (actual->compact == NULL)) {
+		return false;
+	}
+	for (it = 0; it < expected->sequence_length; it++) {
+		if (expected->sequence != NULL && (expected->sequence[it].nt != actual->sequence[it].nt || expected->sequence[it].p != actual->sequence[it].p)) {
+			return false;
+		}
+		if (expected->compact != NULL && (expected->compact[it].nt != actual->compact[it].nt || expected->compact[it].phred != actual->compact[it].phred)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Check that a batch fills in results that start zeroed, and gives the same results as assembling each read pair alone. */
+static bool check_batch(
+	PandaLogProxy logger,
+	bool compact) {
+	panda_seq_identifier ids[PAIRS];
+	panda_qual forward[PAIRS][READ_LENGTH];
+	panda_qual reverse[PAIRS][READ_LENGTH];
+	panda_read_pair pairs[PAIRS];
+	panda_result_seq results[PAIRS];
+	PandaReject rejects[PAIRS];
+	PandaAssembler batch = panda_assembler_new(NULL, NULL, NULL, logger);
+	PandaAssembler single = panda_assembler_new(NULL, NULL, NULL, logger);
+	bool ok = true;
+	size_t assembled = 0;
+	size_t it;
+	panda_assembler_set_compact_results(batch, compact);
+	panda_assembler_set_compact_results(single, compact);
+	for (it = 0; it < PAIRS; it++) {
+		panda_seqid_clear(&ids[it]);
+		ids[it].lane = it;
+		overlapping_reads(forward[it], reverse[it], 20 + 5 * it);
+		pairs[it].name = &ids[it];
+		pairs[it].forward = forward[it];
+		pairs[it].forward_length = READ_LENGTH;
+		pairs[it].reverse = reverse[it];
+		pairs[it].reverse_length = READ_LENGTH;
+	}
+	memset(results, 0, sizeof(results));
+	if (panda_assembler_assemble_batch(batch, pairs, PAIRS, results, rejects) == 0) {
+		fprintf(stderr, "FAILED: nothing assembled in a batch with compact results %s\n", compact ? "on" : "off");
+		ok = false;
+	}
+	for (it = 0; it < PAIRS; it++) {
+		const panda_result_seq *expected = panda_assembler_assemble(single, &ids[it], forward[it], READ_LENGTH, reverse[it], READ_LENGTH);
+		if ((expected != NULL) != (rejects[it] == PANDA_REJECT_NONE) || (expected != NULL && !same_result(expected, &results[it]))) {
+			fprintf(stderr, "FAILED: read pair %zd differs in a batch with compact results %s\n", it, compact ? "on" : "off");
+			ok = false;
+		}
+		if (expected != NULL) {
+			assembled++;
+		}
+	}
+	if (ok && assembled == 0) {
+		fprintf(stderr, "FAILED: nothing assembled alone with compact results %s\n", compact ? "on" : "off");
+		ok = false;
+	}
+	panda_assembler_unref(batch);
+	panda_assembler_unref(single);
+	return ok;
+}
+
+int main(
+	) {
+	PandaLogProxy logger = panda_log_proxy_new_stderr();
+	int exit_code = 0;
+	srand(0);
+	if (!check_batch(logger, false) || !check_batch(logger, true)) {
+		exit_code = 1;
+	}
+	panda_log_proxy_unref(logger);
+	return exit_code;
+}
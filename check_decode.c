@@ -0,0 +1,131 @@
+#include<stdbool.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include "config.h"
+#include "pandaseq.h"
+#include "decode.h"
+#include "nt.h"
+
+static const char *const level_names[] = { "scalar", "SSE4.2", "AVX2" };
+
+/* Make a line of mostly valid characters, with the occasional character from anywhere in the byte range, including ones that are invalid or negative. */
+static void random_line(
+	char *line,
+	size_t length,
+	const char *alphabet) {
+	size_t it;
+	for (it = 0; it < length; it++) {
+		line[it] = (rand() % 50 == 0) ? (char) (rand() % 255 + 1) : alphabet[rand() % strlen(alphabet)];
+	}
+	line[length] = '\0';
+}
+
+/* Check that a decoder gives the same nucleotides, scores, lengths and flags as the scalar one for every line length up to past the maximum. */
+static bool check_level(
+	fastq_decoder_level level,
+	fastq_decode_sequence sequence,
+	fastq_decode_quality quality) {
+	fastq_decode_sequence scalar_sequence;
+	fastq_decode_quality scalar_quality;
+	char line[MAX_LEN + 50];
+	panda_qual expected[MAX_LEN];
+	panda_qual actual[MAX_LEN];
+	size_t length;
+	size_t trial;
+	fastq_decoder_get(FASTQ_DECODER_SCALAR, &scalar_sequence, &scalar_quality);
+	for (trial = 0; trial < 12; trial++) {
+		for (length = 0; length < sizeof(line) - 1; length++) {
+			const panda_nt *table = (trial % 2 == 0) ? iupac_forward : iupac_reverse;
+			unsigned char qualmin = (trial % 3 == 0) ? 64 : 33;
+			size_t max_len = (trial % 4 == 0) ? PANDA_TAG_LEN - 1 : MAX_LEN;
+			bool expected_flag = false;
+			bool actual_flag = false;
+			size_t expected_length;
+			size_t actual_length;
+			size_t it;
+
+			random_line(line, length, "ACGTNacgtnRYKM");
+			expected_length = scalar_sequence(expected, line, length, max_len, table, &expected_flag);
+			actual_length = sequence(actual, line, length, max_len, table, &actual_flag);
+			if (expected_length != actual_length || expected_flag != actual_flag) {
+				fprintf(stderr, "FAILED: %s decoder gives sequence length %zd (%s) instead of %zd (%s) for %s\n", level_names[level], actual_length, actual_flag ? "invalid" : "valid", expected_length, expected_flag ? "invalid" : "valid", line);
+				return false;
+			}
+			for (it = 0; it < expected_length; it++) {
+				if (expected[it].nt != actual[it].nt) {
+					fprintf(stderr, "FAILED: %s decoder gives wrong nucleotide at %zd for %s\n", level_names[level], it, line);
+					return false;
+				}
+			}
+
+			random_line(line, length, "!#+5?@AFIJh");
+			expected_flag = false;
+			actual_flag = false;
+			expected_length = scalar_quality(expected, line, length, max_len, qualmin, &expected_flag);
+			actual_length = quality(actual, line, length, max_len, qualmin, &actual_flag);
+			if (expected_length != actual_length || expected_flag != actual_flag) {
+				fprintf(stderr, "FAILED: %s decoder gives quality length %zd (%s) instead of %zd (%s) for %s\n", level_names[level], actual_length, actual_flag ? "under 64" : "not under 64", expected_length, expected_flag ? "under 64" : "not under 64", line);
+				return false;
+			}
+			for (it = 0; it < expected_length && it < max_len; it++) {
+				if (expected[it].qual != actual[it].qual) {
+					fprintf(stderr, "FAILED: %s decoder gives score %d instead of %d at %zd for %s\n", level_names[level], (int) actual[it].qual, (int) expected[it].qual, it, line);
+					return false;
+				}
+			}
+			/* The scores must not disturb the nucleotides already decoded. */
+			for (it = 0; it < actual_length && it < max_len && it < length; it++) {
+				actual[it].nt = (char) it;
+			}
+			quality(actual, line, length, max_len, qualmin, &actual_flag);
+			for (it = 0; it < actual_length && it < max_len && it < length; it++) {
+				if (actual[it].nt != (char) it) {
+					fprintf(stderr, "FAILED: %s decoder overwrites nucleotide at %zd\n", level_names[level], it);
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+/* Check that a score below 64 past the maximum length is still noticed, since it suggests the file is not PHRED+64. */
+static bool check_under_64_past_max_len(
+	fastq_decoder_level level,
+	fastq_decode_quality quality) {
+	char line[MAX_LEN + 50];
+	panda_qual read[MAX_LEN];
+	bool flag = false;
+	memset(line, 'h', sizeof(line) - 1);
+	line[sizeof(line) - 1] = '\0';
+	line[MAX_LEN + 10] = '5';
+	quality(read, line, sizeof(line) - 1, MAX_LEN, 64, &flag);
+	if (!flag) {
+		fprintf(stderr, "FAILED: %s decoder misses a score under 64 past the maximum length\n", level_names[level]);
+		return false;
+	}
+	return true;
+}
+
+int main(
+	) {
+	fastq_decoder_level level;
+	int exit_code = 0;
+	srand(42);
+	for (level = FASTQ_DECODER_SCALAR; level <= FASTQ_DECODER_AVX2; level++) {
+		fastq_decode_sequence sequence;
+		fastq_decode_quality quality;
+		if (!fastq_decoder_get(level, &sequence, &quality)) {
+			fprintf(stderr, "SKIP: %s decoder not supported\n", level_names[level]);
+			continue;
+		}
+		if (!check_under_64_past_max_len(level, quality)) {
+			exit_code = 1;
+		}
+		if (level != FASTQ_DECODER_SCALAR && !check_level(level, sequence, quality)) {
+			exit_code = 1;
+		}
+	}
+	return exit_code;
+}
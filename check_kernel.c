@@ -0,0 +1,275 @@
+#include<float.h>
+#include<math.h>
+#include<stdbool.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include "config.h"
+#include "pandaseq.h"
+#include "kernel.h"
+#include "table.h"
+
+static const char *const level_names[] = { "scalar", "SSE4.2", "AVX2" };
+
+/* The way each algorithm using the kernels scores a base, as given to overlap_table_init. */
+typedef struct {
+	const char *name;
+	const double (*match)[OVERLAP_TABLE_WIDTH];
+	const double (*mismatch)[OVERLAP_TABLE_WIDTH];
+	double offset;
+	bool unknown_is_special;
+	double unknown;
+} base_scores;
+
+static const base_scores algorithms[] = {
+	{"PEAR", qual_match_pear, qual_mismatch_pear, 0, true, 1.38629},
+	{"RDP MLE", qual_match_simple_bayesian, qual_mismatch_rdp_mle, qual_nn_simple_bayesian, false, 0}
+};
+
+#define NUM_ALGORITHMS (sizeof(algorithms) / sizeof(*algorithms))
+
+/* The kernels add the scores of the bases in a different order than adding them one at a time. Each way of adding at most MAX_LEN scores is within MAX_LEN * DBL_EPSILON times the sum of their sizes of the exact total, so they can differ from each other by twice that. */
+#define REASSOCIATION_TOLERANCE (2 * MAX_LEN * DBL_EPSILON)
+
+static void random_read(
+	panda_qual *read,
+	size_t length) {
+	size_t it;
+	for (it = 0; it < length; it++) {
+		/* Use every nucleotide code, including N and invalid ones, and scores outside the PHRED range to check clamping. */
+		read[it].nt = rand() % 16;
+		read[it].qual = rand() % 60 - 5;
+	}
+}
+
+/* Add up the scores of the bases in an overlap one at a time, in order, as the algorithms did before they used the kernels, and the sum of the sizes of the scores. */
+static double sequential_score(
+	const base_scores *scores,
+	const panda_qual *forward,
+	size_t forward_length,
+	const panda_qual *reverse,
+	size_t reverse_length,
+	size_t overlap,
+	double *magnitude) {
+	double probability = 0;
+	size_t i;
+	*magnitude = 0;
+	for (i = 0; i < overlap; i++) {
+		ptrdiff_t findex = (ptrdiff_t) forward_length + (ptrdiff_t) i - (ptrdiff_t) overlap;
+		ptrdiff_t rindex = (ptrdiff_t) reverse_length - (ptrdiff_t) i - 1;
+		panda_nt f;
+		panda_nt r;
+		double score;
+		if (findex < 0 || rindex < 0)
+			continue;
+		f = forward[findex].nt;
+		r = reverse[rindex].nt;
+		if (scores->unknown_is_special && (PANDA_NT_IS_N(f) || PANDA_NT_IS_N(r))) {
+			score = scores->unknown;
+		} else {
+			score = ((f & r) != 0 ? scores->match : scores->mismatch)[PHREDCLAMP(forward[findex].qual)][PHREDCLAMP(reverse[rindex].qual)] - scores->offset;
+		}
+		probability += score;
+		*magnitude += fabs(score);
+	}
+	return probability;
+}
+
+/* Check that every kernel matches adding the scores one at a time, within rounding. */
+static bool check_sequential(
+	const overlap_table *tables) {
+	overlap_reads reads;
+	panda_qual forward[MAX_LEN];
+	panda_qual reverse[MAX_LEN];
+	overlap_kernel_level level;
+	size_t trial;
+	for (trial = 0; trial < 50; trial++) {
+		size_t forward_length = rand() % MAX_LEN + 1;
+		size_t reverse_length = rand() % MAX_LEN + 1;
+		size_t overlap;
+		size_t t;
+		random_read(forward, forward_length);
+		random_read(reverse, reverse_length);
+		overlap_reads_prepare(&reads, forward, forward_length, reverse, reverse_length);
+		for (t = 0; t < NUM_ALGORITHMS; t++) {
+			for (overlap = 1; overlap <= forward_length + reverse_length; overlap++) {
+				double magnitude;
+				double expected = sequential_score(&algorithms[t], forward, forward_length, reverse, reverse_length, overlap, &magnitude);
+				for (level = OVERLAP_KERNEL_SCALAR; level <= OVERLAP_KERNEL_AVX2; level++) {
+					overlap_kernel kernel = overlap_kernel_get(level);
+					double actual;
+					if (kernel == NULL)
+						continue;
+					actual = overlap_reads_score(kernel, &tables[t], &reads, overlap);
+					if (fabs(actual - expected) > REASSOCIATION_TOLERANCE * magnitude) {
+						fprintf(stderr, "FAILED: %s kernel gives %.17g for %s but adding the bases in order gives %.17g, for lengths %zd and %zd, overlap %zd\n", level_names[level], actual, algorithms[t].name, expected, forward_length, reverse_length, overlap);
+						return false;
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+/* Check that PEAR scores the reverse base with the reverse read's score. It used to take the forward read's score at the same index instead, which gives a different value when the reads' scores differ. */
+static bool check_pear_reverse_score(
+	const overlap_table *table) {
+	panda_qual forward[10];
+	panda_qual reverse[10];
+	size_t it;
+	double old_probability = 5 * qual_match_pear[40][40] + qual_mismatch_pear[40][40];
+	double new_probability = 5 * qual_match_pear[40][10] + qual_mismatch_pear[40][10];
+	double actual;
+	for (it = 0; it < 10; it++) {
+		forward[it].nt = PANDA_NT_A;
+		forward[it].qual = 40;
+		reverse[it].nt = PANDA_NT_A;
+		reverse[it].qual = 10;
+	}
+	reverse[9].nt = PANDA_NT_C;
+	actual = overlap_table_probability(table, forward, 10, reverse, 10, 6);
+	if (fabs(actual - new_probability) > REASSOCIATION_TOLERANCE * fabs(new_probability) || fabs(actual - old_probability) <= REASSOCIATION_TOLERANCE * fabs(old_probability)) {
+		fprintf(stderr, "FAILED: PEAR gives %.17g, which should be %.17g using the reverse read's scores rather than %.17g using the forward read's\n", actual, new_probability, old_probability);
+		return false;
+	}
+	return true;
+}
+
+/* Check that separating the nucleotides and scores of a read gives back the original read, at every length. */
+static bool check_split(
+	void) {
+	panda_qual read[MAX_LEN];
+	read_arrays arrays;
+	size_t length;
+	size_t it;
+	random_read(read, MAX_LEN);
+	for (length = 0; length <= MAX_LEN; length++) {
+		read_arrays_split(&arrays, read, length);
+		if (arrays.length != length) {
+			fprintf(stderr, "FAILED: separated read has length %zd instead of %zd\n", arrays.length, length);
+			return false;
+		}
+		for (it = 0; it < length; it++) {
+			if (arrays.nt[it] != read[it].nt || arrays.qual[it] != read[it].qual) {
+				fprintf(stderr, "FAILED: separated base %zd of a read of length %zd is wrong\n", it, length);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/* Make a pair of reads that overlap by the requested amount, with some errors, so that some overlaps score well and the pruning in overlap_table_best has something to do. */
+static void overlapping_reads(
+	panda_qual *forward,
+	size_t forward_length,
+	panda_qual *reverse,
+	size_t reverse_length,
+	size_t overlap) {
+	size_t it;
+	random_read(forward, forward_length);
+	random_read(reverse, reverse_length);
+	for (it = 0; it < overlap && it < forward_length && it < reverse_length; it++) {
+		if (rand() % 10 != 0) {
+			reverse[reverse_length - it - 1].nt = forward[forward_length - overlap + it].nt;
+		}
+	}
+}
+
+/* Check that abandoning overlaps which cannot win picks the same overlap as scoring all of them, in any order. */
+static bool check_best(
+	const overlap_table *table) {
+	panda_qual forward[MAX_LEN];
+	panda_qual reverse[MAX_LEN];
+	size_t overlaps[2 * MAX_LEN];
+	double probabilities[2 * MAX_LEN];
+	size_t trial;
+	for (trial = 0; trial < 200; trial++) {
+		size_t forward_length = rand() % (MAX_LEN - 20) + 20;
+		size_t reverse_length = rand() % (MAX_LEN - 20) + 20;
+		size_t overlaps_length = 0;
+		size_t it;
+		double expected_probability = -1000;
+		double actual_probability = -1000;
+		ptrdiff_t expected;
+		ptrdiff_t actual;
+		overlapping_reads(forward, forward_length, reverse, reverse_length, rand() % (forward_length < reverse_length ? forward_length : reverse_length) + 1);
+		for (it = 1; it <= forward_length + reverse_length; it++) {
+			if (rand() % 3 == 0) {
+				overlaps[overlaps_length++] = it;
+			}
+		}
+		for (it = overlaps_length; it > 1; it--) {
+			size_t other = rand() % it;
+			size_t temp = overlaps[other];
+			overlaps[other] = overlaps[it - 1];
+			overlaps[it - 1] = temp;
+		}
+		expected = overlap_table_best(table, forward, forward_length, reverse, reverse_length, overlaps, overlaps_length, &expected_probability, probabilities);
+		actual = overlap_table_best(table, forward, forward_length, reverse, reverse_length, overlaps, overlaps_length, &actual_probability, NULL);
+		if (expected != actual || memcmp(&expected_probability, &actual_probability, sizeof(double)) != 0) {
+			fprintf(stderr, "FAILED: pruned search gives overlap %zd (%.17g) instead of %zd (%.17g) for lengths %zd and %zd\n", actual, actual_probability, expected, expected_probability, forward_length, reverse_length);
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(
+	) {
+	overlap_table tables[NUM_ALGORITHMS];
+	overlap_reads reads;
+	panda_qual forward[MAX_LEN];
+	panda_qual reverse[MAX_LEN];
+	overlap_kernel scalar = overlap_kernel_get(OVERLAP_KERNEL_SCALAR);
+	overlap_kernel_level level;
+	size_t table;
+	int exit_code = 0;
+
+	for (table = 0; table < NUM_ALGORITHMS; table++) {
+		overlap_table_init(&tables[table], algorithms[table].match, algorithms[table].mismatch, algorithms[table].offset, algorithms[table].unknown_is_special, algorithms[table].unknown);
+	}
+	srand(42);
+
+	for (level = OVERLAP_KERNEL_SSE42; level <= OVERLAP_KERNEL_AVX2; level++) {
+		overlap_kernel kernel = overlap_kernel_get(level);
+		size_t trial;
+		if (kernel == NULL) {
+			fprintf(stderr, "SKIP: %s kernel not supported\n", level_names[level]);
+			continue;
+		}
+		for (trial = 0; trial < 200; trial++) {
+			size_t forward_length = rand() % MAX_LEN + 1;
+			size_t reverse_length = rand() % MAX_LEN + 1;
+			size_t overlap;
+			size_t t;
+			random_read(forward, forward_length);
+			random_read(reverse, reverse_length);
+			overlap_reads_prepare(&reads, forward, forward_length, reverse, reverse_length);
+			for (t = 0; t < NUM_ALGORITHMS; t++) {
+				for (overlap = 1; overlap <= forward_length + reverse_length; overlap++) {
+					double expected = overlap_reads_score(scalar, &tables[t], &reads, overlap);
+					double actual = overlap_reads_score(kernel, &tables[t], &reads, overlap);
+					if (memcmp(&expected, &actual, sizeof(double)) != 0) {
+						fprintf(stderr, "FAILED: %s kernel gives %.17g instead of %.17g for table %zd, lengths %zd and %zd, overlap %zd\n", level_names[level], actual, expected, t, forward_length, reverse_length, overlap);
+						exit_code = 1;
+						break;
+					}
+				}
+			}
+		}
+	}
+	if (!check_sequential(tables) || !check_pear_reverse_score(&tables[0])) {
+		exit_code = 1;
+	}
+	if (!check_split()) {
+		exit_code = 1;
+	}
+	for (table = 0; table < NUM_ALGORITHMS; table++) {
+		if (!check_best(&tables[table])) {
+			exit_code = 1;
+		}
+	}
+	return exit_code;
+}
@@ -0,0 +1,125 @@
+#include<math.h>
+#include<stdbool.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include "config.h"
+#include "pandaseq.h"
+#include "prob.h"
+#include "table.h"
+
+#define CIRC(index, len) (((index) + (len)) % (len))
+
+/* The original primer search, which scores every alignment, to compare against. */
+static size_t expected_offset(
+	double threshold,
+	double penalty,
+	bool reverse,
+	const panda_nt *nts,
+	const double *p,
+	const double *notp,
+	size_t seq_length,
+	const panda_nt *primer,
+	size_t primerlen) {
+	double probabilities[primerlen];
+	double bestpr = exp(primerlen * threshold);
+	size_t bestindex = 0;
+	size_t index;
+	if (primerlen > seq_length) {
+		return 0;
+	}
+	for (index = 0; index < primerlen; index++) {
+		probabilities[index] = -INFINITY;
+	}
+	for (index = 0; index < seq_length; index++) {
+		size_t position = reverse ? (seq_length - index - 1) : index;
+		ptrdiff_t x;
+		double last_pr = exp(probabilities[CIRC(index, primerlen)] / (index + 1)) - index * penalty;
+		if (last_pr > bestpr) {
+			bestpr = last_pr;
+			bestindex = index + 1;
+		}
+		probabilities[CIRC(index, primerlen)] = 0;
+		for (x = (ptrdiff_t) (primerlen > index ? index : primerlen - 1); x >= 0; x--) {
+			if (!PANDA_NT_IS_N(primer[x])) {
+				probabilities[CIRC(index - x, primerlen)] += ((nts[position] & primer[x]) != 0) ? p[position] : notp[position];
+			}
+		}
+	}
+	return bestindex;
+}
+
+/* Make a sequence that contains a copy of the primer, with some errors, at a random position. Ambiguous nucleotides are common in primers, so the primer uses every code. */
+static void random_case(
+	panda_qual *seq,
+	size_t seq_length,
+	panda_nt *primer,
+	size_t primerlen) {
+	size_t start = rand() % (seq_length - primerlen + 1);
+	size_t it;
+	for (it = 0; it < primerlen; it++) {
+		primer[it] = rand() % 4 == 0 ? rand() % 16 : (1 << (rand() % 4));
+	}
+	for (it = 0; it < seq_length; it++) {
+		seq[it].nt = rand() % 20 == 0 ? rand() % 16 : (1 << (rand() % 4));
+		seq[it].qual = rand() % 50 - 2;
+	}
+	for (it = 0; it < primerlen; it++) {
+		if (rand() % 8 != 0 && primer[it] != 0) {
+			panda_nt nt;
+			do {
+				nt = 1 << (rand() % 4);
+			} while ((nt & primer[it]) == 0);
+			seq[start + it].nt = nt;
+		}
+	}
+}
+
+/* Check that skipping alignments that cannot win finds the same primer position as scoring every alignment, for both kinds of sequences. */
+int main(
+	) {
+	static const double thresholds[] = { -INFINITY, -1, -0.1, -0.01, -0.001 };
+	static const double penalties[] = { 0, 0.001, 0.5, -0.001 };
+	panda_qual qual[MAX_LEN];
+	panda_result result[MAX_LEN];
+	panda_nt nts[MAX_LEN];
+	double p[MAX_LEN];
+	double notp[MAX_LEN];
+	panda_nt primer[MAX_LEN];
+	size_t trial;
+	srand(42);
+
+	for (trial = 0; trial < 20000; trial++) {
+		size_t seq_length = rand() % MAX_LEN + 1;
+		size_t primerlen = rand() % (seq_length < 40 ? seq_length : 40) + 1;
+		double threshold = thresholds[rand() % (sizeof(thresholds) / sizeof(*thresholds))];
+		double penalty = penalties[rand() % (sizeof(penalties) / sizeof(*penalties))];
+		bool reverse = rand() % 2;
+		size_t expected;
+		size_t actual;
+		size_t it;
+		random_case(qual, seq_length, primer, primerlen);
+		for (it = 0; it < seq_length; it++) {
+			nts[it] = result[it].nt = qual[it].nt;
+			p[it] = qual_score[PHREDCLAMP(qual[it].qual)];
+			notp[it] = qual_score_err[PHREDCLAMP(qual[it].qual)];
+		}
+		expected = expected_offset(threshold, penalty, reverse, nts, p, notp, seq_length, primer, primerlen);
+		actual = panda_compute_offset_qual(threshold, penalty, reverse, qual, seq_length, primer, primerlen);
+		if (expected != actual) {
+			fprintf(stderr, "FAILED: primer of length %zd found at %zd instead of %zd in read of length %zd (threshold %g, penalty %g, %s)\n", primerlen, actual, expected, seq_length, threshold, penalty, reverse ? "reverse" : "forward");
+			return 1;
+		}
+
+		for (it = 0; it < seq_length; it++) {
+			result[it].p = p[it] = log(1 - (rand() % 1000 + 1) / 1001.0);
+			notp[it] = panda_log1mexp(p[it]);
+		}
+		expected = expected_offset(threshold, penalty, reverse, nts, p, notp, seq_length, primer, primerlen);
+		actual = panda_compute_offset_result(threshold, penalty, reverse, result, seq_length, primer, primerlen);
+		if (expected != actual) {
+			fprintf(stderr, "FAILED: primer of length %zd found at %zd instead of %zd in assembled sequence of length %zd (threshold %g, penalty %g, %s)\n", primerlen, actual, expected, seq_length, threshold, penalty, reverse ? "reverse" : "forward");
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,74 @@
+#include<stdbool.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include "config.h"
+#include "pandaseq.h"
+#include "packed.h"
+
+/* Lengths on either side of the word boundaries, where the windows straddle two words, and the longest read. */
+static const size_t edge_lengths[] = { 1, 63, 64, 65, 127, 128, 129, 191, 193, MAX_LEN - 1, MAX_LEN };
+
+#define NUM_EDGE_LENGTHS (sizeof(edge_lengths) / sizeof(*edge_lengths))
+
+static void random_read(
+	panda_qual *read,
+	size_t length) {
+	size_t it;
+	for (it = 0; it < length; it++) {
+		/* Use every nucleotide code, including N and ambiguous ones, but make N common enough to appear in most overlaps. */
+		read[it].nt = rand() % 4 == 0 ? (panda_nt) 0x0F : rand() % 16;
+		read[it].qual = 40;
+	}
+}
+
+/* Check that counting the bit planes matches counting one base at a time, for every overlap of a pair of reads. */
+static bool check_pair(
+	size_t forward_length,
+	size_t reverse_length) {
+	panda_qual forward[MAX_LEN];
+	panda_qual reverse[MAX_LEN];
+	packed_seq forward_packed;
+	packed_seq reverse_packed;
+	size_t overlap;
+	random_read(forward, forward_length);
+	random_read(reverse, reverse_length);
+	packed_seq_build(&forward_packed, forward, forward_length, false);
+	packed_seq_build(&reverse_packed, reverse, reverse_length, true);
+	for (overlap = 1; overlap <= forward_length + reverse_length; overlap++) {
+		size_t expected_matches;
+		size_t expected_mismatches;
+		size_t expected_unknowns;
+		size_t matches;
+		size_t mismatches;
+		size_t unknowns;
+		count_overlap(forward, forward_length, reverse, reverse_length, overlap, &expected_matches, &expected_mismatches, &expected_unknowns);
+		packed_seq_count(&forward_packed, &reverse_packed, overlap, &matches, &mismatches, &unknowns);
+		if (matches != expected_matches || mismatches != expected_mismatches || unknowns != expected_unknowns) {
+			fprintf(stderr, "FAILED: packed reads give %zd/%zd/%zd instead of %zd/%zd/%zd matches/mismatches/unknowns for lengths %zd and %zd, overlap %zd\n", matches, mismatches, unknowns, expected_matches, expected_mismatches, expected_unknowns, forward_length, reverse_length, overlap);
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(
+	) {
+	size_t forward;
+	size_t reverse;
+	size_t trial;
+	int exit_code = 0;
+	srand(42);
+	for (forward = 0; forward < NUM_EDGE_LENGTHS; forward++) {
+		for (reverse = 0; reverse < NUM_EDGE_LENGTHS; reverse++) {
+			if (!check_pair(edge_lengths[forward], edge_lengths[reverse])) {
+				exit_code = 1;
+			}
+		}
+	}
+	for (trial = 0; trial < 200; trial++) {
+		if (!check_pair(rand() % MAX_LEN + 1, rand() % MAX_LEN + 1)) {
+			exit_code = 1;
+		}
+	}
+	return exit_code;
+}
@@ -0,0 +1,71 @@
+#include<stdbool.h>
+#include<stdio.h>
+#include<string.h>
+#include "config.h"
+#include "pandaseq.h"
+
+bool validtag_LTX_opener(
+	PandaLogProxy logger,
+	const char *args,
+	PandaPreCheck *precheck,
+	PandaCheck *check,
+	void **user_data,
+	PandaDestroy *destroy);
+
+typedef struct {
+	const char *args;
+	const char *tag;
+	bool valid;
+	const char *corrected;
+} test_case;
+
+const test_case checks[] = {
+	{"ACGTAC:GGGGGG", "ACGTAC", true, "ACGTAC"},
+	{"ACGTAC:GGGGGG", "GGGCGG", false, NULL},
+	{"ACGTAC:GGGGGG", "", false, NULL},
+	/* A single error is fixed, including an unknown base. */
+	{"correct:ACGTAC:GGGGGG", "GGGCGG", true, "GGGGGG"},
+	{"correct:ACGTAC:GGGGGG", "ACNTAC", true, "ACGTAC"},
+	{"correct:ACGTAC:GGGGGG", "ACGTCA", false, NULL},
+	/* ACGTAT is one error from both tags, so it cannot be fixed. */
+	{"correct:ACGTAC:ACGTTT", "ACGTAT", false, NULL},
+	{"correct:ACGTAC:ACGTTT", "ACGTAG", true, "ACGTAC"},
+	/* A valid tag is never corrected to a neighbouring one, in either order. */
+	{"correct:ACGTAC:ACGTAA", "ACGTAA", true, "ACGTAA"},
+	{"correct:ACGTAA:ACGTAC", "ACGTAA", true, "ACGTAA"},
+	{"correct:ACGTAA:ACGTAC", "ACGTAC", true, "ACGTAC"}
+};
+
+/* Check that the tags are checked and, if requested, corrected in the identifier. */
+bool check(
+	PandaLogProxy logger,
+	const test_case *test) {
+	PandaPreCheck precheck = NULL;
+	PandaCheck postcheck = NULL;
+	void *user_data = NULL;
+	PandaDestroy destroy = NULL;
+	panda_seq_identifier id;
+	bool valid;
+	if (!validtag_LTX_opener(logger, test->args, &precheck, &postcheck, &user_data, &destroy) || precheck == NULL) {
+		return false;
+	}
+	panda_seqid_clear(&id);
+	strcpy(id.tag, test->tag);
+	valid = precheck(logger, &id, NULL, 0, NULL, 0, user_data);
+	destroy(user_data);
+	return valid == test->valid && (!valid || strcmp(id.tag, test->corrected) == 0);
+}
+
+int main(
+	) {
+	PandaLogProxy logger = panda_log_proxy_new_stderr();
+	int exit_code = 0;
+	for (size_t it = 0; it < sizeof(checks) / sizeof(*checks); it++) {
+		if (!check(logger, checks + it)) {
+			fprintf(stderr, "FAILED: %s with %s\n", checks[it].tag, checks[it].args);
+			exit_code = 1;
+		}
+	}
+	panda_log_proxy_unref(logger);
+	return exit_code;
+}
@@ -0,0 +1,265 @@
+/* PANDAseq -- Assemble paired FASTQ Illumina reads and strip the region between amplification primers.
+     Copyright (C) 2011-2013  Andre Masella
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+#include "config.h"
+#include "pandaseq.h"
+#include "decode.h"
+#include "prob.h"
+#if defined(HAVE_IMMINTRIN_H) && defined(__x86_64__) && defined(__GNUC__)
+#        define X86_KERNELS
+#        include <immintrin.h>
+#endif
+
+#define TOINDEX(val) (((int)(val)) < qualmin ? 0 : (((int)(val)) > qualmin + PHREDMAX ? PHREDMAX : ((int)(val)) - qualmin))
+/* The vector decoders compare signed bytes, so the largest character that is not clamped must be positive. */
+#define VECTOR_QUALMIN_OK(qualmin) ((qualmin) + PHREDMAX <= 127)
+
+static size_t sequence_scalar(
+	panda_qual *read,
+	const char *line,
+	size_t line_length,
+	size_t max_len,
+	const panda_nt *table,
+	bool *invalid) {
+	size_t length = line_length < max_len ? line_length : max_len;
+	size_t i;
+	for (i = 0; i < length; i++) {
+		if ((read[i].nt = table[line[i] & 0x1F]) == '\0') {
+			*invalid = true;
+			return i;
+		}
+	}
+	return length;
+}
+
+static size_t quality_scalar(
+	panda_qual *read,
+	const char *line,
+	size_t line_length,
+	size_t max_len,
+	unsigned char qualmin,
+	bool *under_64) {
+	size_t length = line_length < max_len ? line_length : max_len;
+	size_t i;
+	for (i = 0; i < length; i++) {
+		if (line[i] < 64) {
+			*under_64 = true;
+		}
+		read[i].qual = TOINDEX(line[i]);
+	}
+	/* The scores past the maximum length are not stored, but they still say whether the file is PHRED+64. */
+	for (; i < line_length && !*under_64; i++) {
+		if (line[i] < 64) {
+			*under_64 = true;
+		}
+	}
+	return line_length;
+}
+
+#ifdef X86_KERNELS
+/* Translate sixteen characters at a time. The table has 32 entries, but a shuffle only looks up 16, so both halves are looked up and the fifth bit of the character chooses between them. The nucleotides are interleaved with zeros for the scores, which are filled in later. */
+__attribute__ ((target("sse4.2")))
+static size_t sequence_sse42(
+	panda_qual *read,
+	const char *line,
+	size_t line_length,
+	size_t max_len,
+	const panda_nt *table,
+	bool *invalid) {
+	const __m128i low_table = _mm_loadu_si128((const __m128i *) table);
+	const __m128i high_table = _mm_loadu_si128((const __m128i *) (table + 16));
+	const __m128i low_bits = _mm_set1_epi8(0x0F);
+	const __m128i fifth_bit = _mm_set1_epi8(0x10);
+	const __m128i zero = _mm_setzero_si128();
+	size_t length = line_length < max_len ? line_length : max_len;
+	size_t i;
+	for (i = 0; i + 16 <= length; i += 16) {
+		__m128i c = _mm_loadu_si128((const __m128i *) (line + i));
+		__m128i index = _mm_and_si128(c, low_bits);
+		__m128i nt = _mm_blendv_epi8(_mm_shuffle_epi8(low_table, index), _mm_shuffle_epi8(high_table, index), _mm_cmpeq_epi8(_mm_and_si128(c, fifth_bit), fifth_bit));
+		int bad = _mm_movemask_epi8(_mm_cmpeq_epi8(nt, zero));
+		_mm_storeu_si128((__m128i *) (read + i), _mm_unpacklo_epi8(nt, zero));
+		_mm_storeu_si128((__m128i *) (read + i + 8), _mm_unpackhi_epi8(nt, zero));
+		if (bad != 0) {
+			*invalid = true;
+			return i + __builtin_ctz(bad);
+		}
+	}
+	return i + sequence_scalar(read + i, line + i, length - i, length - i, table, invalid);
+}
+
+/* Convert sixteen scores at a time, merging them into the odd bytes of the read, leaving the nucleotides. */
+__attribute__ ((target("sse4.2")))
+static size_t quality_sse42(
+	panda_qual *read,
+	const char *line,
+	size_t line_length,
+	size_t max_len,
+	unsigned char qualmin,
+	bool *under_64) {
+	const __m128i lowest = _mm_set1_epi8(qualmin);
+	const __m128i highest = _mm_set1_epi8(qualmin + PHREDMAX);
+	const __m128i sixty_four = _mm_set1_epi8(64);
+	const __m128i nucleotides = _mm_set1_epi16(0x00FF);
+	const __m128i zero = _mm_setzero_si128();
+	size_t length = line_length < max_len ? line_length : max_len;
+	size_t i = 0;
+	int under = 0;
+	if (VECTOR_QUALMIN_OK(qualmin)) {
+		for (; i + 16 <= length; i += 16) {
+			__m128i c = _mm_loadu_si128((const __m128i *) (line + i));
+			__m128i qual = _mm_sub_epi8(_mm_min_epi8(_mm_max_epi8(c, lowest), highest), lowest);
+			under |= _mm_movemask_epi8(_mm_cmplt_epi8(c, sixty_four));
+			_mm_storeu_si128((__m128i *) (read + i), _mm_or_si128(_mm_and_si128(_mm_loadu_si128((const __m128i *) (read + i)), nucleotides), _mm_unpacklo_epi8(zero, qual)));
+			_mm_storeu_si128((__m128i *) (read + i + 8), _mm_or_si128(_mm_and_si128(_mm_loadu_si128((const __m128i *) (read + i + 8)), nucleotides), _mm_unpackhi_epi8(zero, qual)));
+		}
+	}
+	if (under != 0) {
+		*under_64 = true;
+	}
+	quality_scalar(read + i, line + i, line_length - i, length - i, qualmin, under_64);
+	return line_length;
+}
+
+/* As for SSE4.2, but 32 characters at a time. Shuffling and interleaving work within each half of the register, so the quarters are reordered before interleaving to keep the bases in order. */
+__attribute__ ((target("avx2")))
+static size_t sequence_avx2(
+	panda_qual *read,
+	const char *line,
+	size_t line_length,
+	size_t max_len,
+	const panda_nt *table,
+	bool *invalid) {
+	const __m256i low_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) table));
+	const __m256i high_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) (table + 16)));
+	const __m256i low_bits = _mm256_set1_epi8(0x0F);
+	const __m256i fifth_bit = _mm256_set1_epi8(0x10);
+	const __m256i zero = _mm256_setzero_si256();
+	size_t length = line_length < max_len ? line_length : max_len;
+	size_t i;
+	for (i = 0; i + 32 <= length; i += 32) {
+		__m256i c = _mm256_loadu_si256((const __m256i *) (line + i));
+		__m256i index = _mm256_and_si256(c, low_bits);
+		__m256i nt = _mm256_blendv_epi8(_mm256_shuffle_epi8(low_table, index), _mm256_shuffle_epi8(high_table, index), _mm256_cmpeq_epi8(_mm256_and_si256(c, fifth_bit), fifth_bit));
+		unsigned int bad = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(nt, zero));
+		nt = _mm256_permute4x64_epi64(nt, 0xD8);
+		_mm256_storeu_si256((__m256i *) (read + i), _mm256_unpacklo_epi8(nt, zero));
+		_mm256_storeu_si256((__m256i *) (read + i + 16), _mm256_unpackhi_epi8(nt, zero));
+		if (bad != 0) {
+			*invalid = true;
+			return i + __builtin_ctz(bad);
+		}
+	}
+	return i + sequence_sse42(read + i, line + i, length - i, length - i, table, invalid);
+}
+
+__attribute__ ((target("avx2")))
+static size_t quality_avx2(
+	panda_qual *read,
+	const char *line,
+	size_t line_length,
+	size_t max_len,
+	unsigned char qualmin,
+	bool *under_64) {
+	const __m256i lowest = _mm256_set1_epi8(qualmin);
+	const __m256i highest = _mm256_set1_epi8(qualmin + PHREDMAX);
+	const __m256i sixty_four = _mm256_set1_epi8(64);
+	const __m256i nucleotides = _mm256_set1_epi16(0x00FF);
+	const __m256i zero = _mm256_setzero_si256();
+	size_t length = line_length < max_len ? line_length : max_len;
+	size_t i = 0;
+	unsigned int under = 0;
+	if (VECTOR_QUALMIN_OK(qualmin)) {
+		for (; i + 32 <= length; i += 32) {
+			__m256i c = _mm256_loadu_si256((const __m256i *) (line + i));
+			__m256i qual = _mm256_permute4x64_epi64(_mm256_sub_epi8(_mm256_min_epi8(_mm256_max_epi8(c, lowest), highest), lowest), 0xD8);
+			under |= (unsigned int) _mm256_movemask_epi8(_mm256_cmpgt_epi8(sixty_four, c));
+			_mm256_storeu_si256((__m256i *) (read + i), _mm256_or_si256(_mm256_and_si256(_mm256_loadu_si256((const __m256i *) (read + i)), nucleotides), _mm256_unpacklo_epi8(zero, qual)));
+			_mm256_storeu_si256((__m256i *) (read + i + 16), _mm256_or_si256(_mm256_and_si256(_mm256_loadu_si256((const __m256i *) (read + i + 16)), nucleotides), _mm256_unpackhi_epi8(zero, qual)));
+		}
+	}
+	if (under != 0) {
+		*under_64 = true;
+	}
+	quality_sse42(read + i, line + i, line_length - i, length - i, qualmin, under_64);
+	return line_length;
+}
+#endif
+
+bool fastq_decoder_get(
+	fastq_decoder_level level,
+	fastq_decode_sequence *sequence,
+	fastq_decode_quality *quality) {
+	switch (level) {
+	case FASTQ_DECODER_SCALAR:
+		*sequence = sequence_scalar;
+		*quality = quality_scalar;
+		return true;
+#ifdef X86_KERNELS
+	case FASTQ_DECODER_SSE42:
+		__builtin_cpu_init();
+		*sequence = sequence_sse42;
+		*quality = quality_sse42;
+		return __builtin_cpu_supports("sse4.2");
+	case FASTQ_DECODER_AVX2:
+		__builtin_cpu_init();
+		*sequence = sequence_avx2;
+		*quality = quality_avx2;
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return false;
+	}
+}
+
+static fastq_decode_sequence best_sequence = sequence_scalar;
+static fastq_decode_quality best_quality = quality_scalar;
+
+__attribute__ ((constructor))
+static void decoder_init(
+	void) {
+	fastq_decoder_level level;
+	for (level = FASTQ_DECODER_AVX2; level > FASTQ_DECODER_SCALAR; level--) {
+		fastq_decode_sequence sequence;
+		fastq_decode_quality quality;
+		if (fastq_decoder_get(level, &sequence, &quality)) {
+			best_sequence = sequence;
+			best_quality = quality;
+			return;
+		}
+	}
+}
+
+size_t fastq_decode_sequence_best(
+	panda_qual *read,
+	const char *line,
+	size_t line_length,
+	size_t max_len,
+	const panda_nt *table,
+	bool *invalid) {
+	return best_sequence(read, line, line_length, max_len, table, invalid);
+}
+
+size_t fastq_decode_quality_best(
+	panda_qual *read,
+	const char *line,
+	size_t line_length,
+	size_t max_len,
+	unsigned char qualmin,
+	bool *under_64) {
+	return best_quality(read, line, line_length, max_len, qualmin, under_64);
+}
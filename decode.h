@@ -0,0 +1,85 @@
+/* PANDAseq -- Assemble paired FASTQ Illumina reads and strip the region between amplification primers.
+     Copyright (C) 2011-2013  Andre Masella
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+#ifndef DECODE_H
+#        define DECODE_H
+#        include <stdbool.h>
+#        include <stddef.h>
+#        include "config.h"
+#        include "pandaseq.h"
+
+/*
+ * Translate the sequence line of a FASTQ record into the nucleotides of a read, using a table indexed by the low five bits of each character, such as iupac_forward.
+ *
+ * At most max_len characters are translated and the number translated is returned. Translation stops at the first character the table maps to nothing, which sets invalid.
+ */
+typedef size_t (
+	*fastq_decode_sequence) (
+	panda_qual *read,
+	const char *line,
+	size_t line_length,
+	size_t max_len,
+	const panda_nt *table,
+	bool *invalid);
+
+/*
+ * Convert the quality line of a FASTQ record into the PHRED scores of a read, removing the offset and clamping to the range of the probability tables.
+ *
+ * At most max_len scores are stored, but the length of the whole line is returned, so a mismatch with the sequence can be detected. Any character below 64 in the line, even past max_len, sets under_64, which suggests the file is not PHRED+64.
+ */
+typedef size_t (
+	*fastq_decode_quality) (
+	panda_qual *read,
+	const char *line,
+	size_t line_length,
+	size_t max_len,
+	unsigned char qualmin,
+	bool *under_64);
+
+typedef enum {
+	FASTQ_DECODER_SCALAR,
+	FASTQ_DECODER_SSE42,
+	FASTQ_DECODER_AVX2,
+} fastq_decoder_level;
+
+/*
+ * Get the decoders for a particular instruction set. Returns false if the processor or the build does not support it.
+ */
+bool fastq_decoder_get(
+	fastq_decoder_level level,
+	fastq_decode_sequence *sequence,
+	fastq_decode_quality *quality);
+
+/*
+ * Decode using the best instructions available on this processor.
+ */
+size_t fastq_decode_sequence_best(
+	panda_qual *read,
+	const char *line,
+	size_t line_length,
+	size_t max_len,
+	const panda_nt *table,
+	bool *invalid);
+
+size_t fastq_decode_quality_best(
+	panda_qual *read,
+	const char *line,
+	size_t line_length,
+	size_t max_len,
+	unsigned char qualmin,
+	bool *under_64);
+#endif
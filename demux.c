@@ -0,0 +1,194 @@
+/* PANDAseq -- Assemble paired FASTQ Illumina reads and strip the region between amplification primers.
+     Copyright (C) 2011-2013  Andre Masella
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD
+#        include <pthread.h>
+
+/* All demultiplexers share a single mutex to control reference counts */
+static pthread_mutex_t ref_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+#include "pandaseq.h"
+
+struct sample {
+	char tag[PANDA_TAG_LEN];
+	PandaWriter writer;
+	volatile long count;
+};
+
+struct panda_demux {
+	volatile size_t refcnt;
+	PandaOutputSeq output;
+	PandaLogProxy logger;
+	PandaWriter unknown;
+	volatile long unknown_count;
+	struct sample *samples;
+	size_t samples_length;
+	size_t samples_size;
+	/* An open-addressed hash table of sample indices, plus one, so that zero is an empty slot. Its size is a power of two at least twice the number of samples. */
+	size_t *table;
+	size_t table_size;
+};
+
+static size_t hash_tag(
+	const char *tag) {
+	size_t hash = 2166136261u;
+	for (; *tag != '\0'; tag++) {
+		hash = (hash ^ (unsigned char) *tag) * 16777619u;
+	}
+	return hash;
+}
+
+/* Find the slot holding a tag or the empty slot where it should go. */
+static size_t *find_slot(
+	size_t *table,
+	size_t table_size,
+	const struct sample *samples,
+	const char *tag) {
+	size_t slot = hash_tag(tag) & (table_size - 1);
+	while (table[slot] != 0 && strcmp(samples[table[slot] - 1].tag, tag) != 0) {
+		slot = (slot + 1) & (table_size - 1);
+	}
+	return &table[slot];
+}
+
+PandaDemux panda_demux_new(
+	PandaOutputSeq output,
+	PandaWriter unknown,
+	PandaLogProxy logger) {
+	PandaDemux demux = malloc(sizeof(struct panda_demux));
+	if (demux == NULL)
+		return NULL;
+	demux->refcnt = 1;
+	demux->output = output;
+	demux->logger = logger == NULL ? NULL : panda_log_proxy_ref(logger);
+	demux->unknown = panda_writer_ref(unknown);
+	demux->unknown_count = 0;
+	demux->samples = NULL;
+	demux->samples_length = 0;
+	demux->samples_size = 0;
+	demux->table_size = 16;
+	demux->table = calloc(demux->table_size, sizeof(size_t));
+	return demux;
+}
+
+bool panda_demux_add(
+	PandaDemux demux,
+	const char *tag,
+	PandaWriter writer) {
+	size_t *slot;
+	if (*tag == '\0' || strlen(tag) >= PANDA_TAG_LEN || *(slot = find_slot(demux->table, demux->table_size, demux->samples, tag)) != 0) {
+		return false;
+	}
+	if (demux->samples_length == demux->samples_size) {
+		demux->samples_size = demux->samples_size == 0 ? 8 : 2 * demux->samples_size;
+		demux->samples = realloc(demux->samples, demux->samples_size * sizeof(struct sample));
+	}
+	memcpy(demux->samples[demux->samples_length].tag, tag, strlen(tag) + 1);
+	demux->samples[demux->samples_length].writer = panda_writer_ref(writer);
+	demux->samples[demux->samples_length].count = 0;
+	*slot = ++demux->samples_length;
+
+	if (2 * demux->samples_length > demux->table_size) {
+		size_t table_size = 2 * demux->table_size;
+		size_t *table = calloc(table_size, sizeof(size_t));
+		size_t it;
+		for (it = 0; it < demux->samples_length; it++) {
+			*find_slot(table, table_size, demux->samples, demux->samples[it].tag) = it + 1;
+		}
+		free(demux->table);
+		demux->table = table;
+		demux->table_size = table_size;
+	}
+	return true;
+}
+
+long panda_demux_get_count(
+	PandaDemux demux,
+	const char *tag) {
+	size_t index;
+	if (tag == NULL)
+		return demux->unknown_count;
+	index = *find_slot(demux->table, demux->table_size, demux->samples, tag);
+	return index == 0 ? 0 : demux->samples[index - 1].count;
+}
+
+bool panda_output_demux(
+	const panda_result_seq *sequence,
+	PandaDemux demux) {
+	size_t index = *find_slot(demux->table, demux->table_size, demux->samples, sequence->name.tag);
+	PandaWriter writer;
+	volatile long *count;
+	if (index == 0) {
+		writer = demux->unknown;
+		count = &demux->unknown_count;
+	} else {
+		writer = demux->samples[index - 1].writer;
+		count = &demux->samples[index - 1].count;
+	}
+#ifdef HAVE_PTHREAD
+	__sync_fetch_and_add(count, 1);
+#else
+	(*count)++;
+#endif
+	return demux->output(sequence, writer);
+}
+
+PandaDemux panda_demux_ref(
+	PandaDemux demux) {
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&ref_lock);
+#endif
+	demux->refcnt++;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&ref_lock);
+#endif
+	return demux;
+}
+
+void panda_demux_unref(
+	PandaDemux demux) {
+	size_t count;
+	size_t it;
+	if (demux == NULL)
+		return;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&ref_lock);
+#endif
+	count = --(demux->refcnt);
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&ref_lock);
+#endif
+	if (count == 0) {
+		for (it = 0; it < demux->samples_length; it++) {
+			if (demux->logger != NULL) {
+				panda_log_proxy_write_f(demux->logger, "STAT\tDEMUX\t%s\t%ld\n", demux->samples[it].tag, demux->samples[it].count);
+			}
+			panda_writer_unref(demux->samples[it].writer);
+		}
+		if (demux->logger != NULL) {
+			panda_log_proxy_write_f(demux->logger, "STAT\tDEMUXUNKNOWN\t%ld\n", demux->unknown_count);
+			panda_log_proxy_unref(demux->logger);
+		}
+		panda_writer_unref(demux->unknown);
+		free(demux->samples);
+		free(demux->table);
+		free(demux);
+	}
+}
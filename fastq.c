@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include "pandaseq.h"
 #include "buffer.h"
+#include "decode.h"
 #include "misc.h"
 #include "nt.h"
 #include "prob.h"
@@ -41,7 +42,6 @@ struct fastq_data {
 
 #define LOG(flag, code) do { if(panda_debug_flags & flag) panda_log_proxy_write(data->logger, (code), NULL, id, NULL); } while(0)
 #define LOGV(flag, code, fmt, ...) do { if(panda_debug_flags & flag) { snprintf(static_buffer(), BUFFER_SIZE, fmt, __VA_ARGS__); panda_log_proxy_write(data->logger, (code), NULL, id, static_buffer()); }} while(0)
-#define TOINDEX(val) (((int)(val)) < data->qualmin ? 0 : ((((int)(val)) > data->qualmin + PHREDMAX ? PHREDMAX : (int)(val)) - data->qualmin))
 static bool read_seq(
 	panda_seq_identifier *id,
 	panda_qual *buffer,
@@ -51,27 +51,28 @@ static bool read_seq(
 	struct fastq_data *data,
 	size_t *length) {
 	const char *input;
-	size_t pos = 0;
-	size_t qpos = 0;
-	input = panda_linebuf_next(linebuf);
+	size_t input_length;
+	size_t pos;
+	size_t qpos;
+	bool invalid = false;
+	input = panda_linebuf_next_length(linebuf, &input_length);
 	if (input == NULL) {
 		LOG(PANDA_DEBUG_FILE, PANDA_CODE_PREMATURE_EOF);
 		return false;
 	}
-	for (; *input != '\0' && pos < max_len; input++) {
-		if ((buffer[pos++].nt = table[*input & 0x1F]) == '\0') {
-			LOGV(PANDA_DEBUG_FILE, PANDA_CODE_BAD_NT, "%c@%zd", *input, pos);
-			return false;
-		}
+	pos = fastq_decode_sequence_best(buffer, input, input_length, max_len, table, &invalid);
+	if (invalid) {
+		LOGV(PANDA_DEBUG_FILE, PANDA_CODE_BAD_NT, "%c@%zd", input[pos], pos + 1);
+		return false;
 	}
-	input = panda_linebuf_next(linebuf);
+	input = panda_linebuf_next_length(linebuf, &input_length);
 	if (input == NULL) {
 		LOG(PANDA_DEBUG_FILE, PANDA_CODE_PREMATURE_EOF);
 		return false;
 	}
-	if (*input != '+') {
+	if (input_length == 0 || *input != '+') {
 		/* Check if we have more sequence... */
-		if ((table[*input & 0x1F]) != '\0') {
+		if (input_length > 0 && (table[*input & 0x1F]) != '\0') {
 			LOG(PANDA_DEBUG_FILE, PANDA_CODE_READ_TOO_LONG);
 		} else {
 			/* Or just junk... */
@@ -79,17 +80,12 @@ static bool read_seq(
 		}
 		return false;
 	}
-	input = panda_linebuf_next(linebuf);
+	input = panda_linebuf_next_length(linebuf, &input_length);
 	if (input == NULL) {
 		LOG(PANDA_DEBUG_FILE, PANDA_CODE_PREMATURE_EOF);
 		return false;
 	}
-	for (; *input != '\0'; input++) {
-		if (*input < 64) {
-			data->seen_under_64 = true;
-		}
-		buffer[qpos++].qual = TOINDEX(*input);
-	}
+	qpos = fastq_decode_quality_best(buffer, input, input_length, max_len, data->qualmin, &data->seen_under_64);
 
 	if (qpos != pos) {
 		LOG(PANDA_DEBUG_FILE, PANDA_CODE_NO_QUALITY_INFO);
@@ -103,8 +99,6 @@ static bool read_seq(
 	return true;
 }
 
-#undef TOINDEX
-
 static bool stream_next_seq(
 	panda_seq_identifier *id,
 	panda_qual **forward,
@@ -221,11 +215,23 @@ PandaNextSeq panda_create_fastq_reader(
 	PandaDestroy index_destroy,
 	void **user_data,
 	PandaDestroy *destroy) {
+	return fastq_reader_new(panda_linebuf_new(forward, forward_data, forward_destroy), panda_linebuf_new(reverse, reverse_data, reverse_destroy), logger, qualmin, policy, panda_linebuf_new(index, index_data, index_destroy), user_data, destroy);
+}
+
+PandaNextSeq fastq_reader_new(
+	PandaLineBuf forward,
+	PandaLineBuf reverse,
+	PandaLogProxy logger,
+	unsigned char qualmin,
+	PandaTagging policy,
+	PandaLineBuf index,
+	void **user_data,
+	PandaDestroy *destroy) {
 	struct fastq_data *data;
 	data = malloc(sizeof(struct fastq_data));
-	data->forward = panda_linebuf_new(forward, forward_data, forward_destroy);
-	data->reverse = panda_linebuf_new(reverse, reverse_data, reverse_destroy);
-	data->index = panda_linebuf_new(index, index_data, index_destroy);
+	data->forward = forward;
+	data->reverse = reverse;
+	data->index = index;
 	data->logger = panda_log_proxy_ref(logger);
 	data->qualmin = qualmin;
 	data->policy = index == NULL ? policy : PANDA_TAG_OPTIONAL;
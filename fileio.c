@@ -15,11 +15,17 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
  */
+#define _XOPEN_SOURCE 600
 #include "config.h"
 #include <bzlib.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+#        include <sys/mman.h>
+#endif
 #include <zlib.h>
 #if HAVE_PTHREAD
 #        include <pthread.h>
@@ -28,73 +34,387 @@
 #include "misc.h"
 #ifdef HAVE_PTHREAD
 #        include"pandaseq-mux.h"
+#        include "readahead.h"
 #endif
 
-static bool buff_read_gz(
+#define STREAM_BUFFER_SIZE (64 * 1024)
+
+/* A file, or a pipe, where the bytes read to detect the compression are given back before the rest of the data, since pipes can't be rewound. */
+struct fd_stream {
+	int fd;
+	/* Enough for a BGZF header. */
+	char peek[18];
+	size_t peek_length;
+	size_t peek_offset;
+};
+
+static bool fd_read(
+	int fd,
+	char *buf,
+	size_t buf_len,
+	size_t *read_length) {
+	ssize_t code;
+	do {
+		code = read(fd, buf, buf_len);
+	} while (code < 0 && errno == EINTR);
+	if (code < 0) {
+		*read_length = 0;
+		return false;
+	}
+	*read_length = code;
+	return true;
+}
+
+static bool fd_stream_read(
 	char *buf,
 	size_t buf_len,
 	size_t *read,
 	void *data) {
-	gzFile file = (gzFile) data;
-	int code;
-	code = gzread(file, buf, buf_len);
-	if (code < 1) {
-		*read = 0;
-		return gzeof(file);
-	}
-	*read = code;
+	struct fd_stream *stream = (struct fd_stream *) data;
+	if (stream->peek_offset < stream->peek_length) {
+		*read = stream->peek_length - stream->peek_offset < buf_len ? stream->peek_length - stream->peek_offset : buf_len;
+		memcpy(buf, stream->peek + stream->peek_offset, *read);
+		stream->peek_offset += *read;
+		return true;
+	}
+	return fd_read(stream->fd, buf, buf_len, read);
+}
+
+static void fd_stream_destroy(
+	struct fd_stream *stream) {
+	/* Standard input belongs to the program, so it stays open for anyone else who wants it. */
+	if (stream->fd != STDIN_FILENO) {
+		close(stream->fd);
+	}
+	free(stream);
+}
+
+/* Compressed files may be several complete streams one after another, as written by BGZF or parallel compressors, so decompression starts over when one ends. */
+struct gz_stream {
+	z_stream strm;
+	bool stream_end;
+	size_t streams;
+	 MANAGED_MEMBER(
+		PandaBufferRead,
+		source);
+	unsigned char buffer[STREAM_BUFFER_SIZE];
+};
+
+static bool gz_stream_read(
+	char *buf,
+	size_t buf_len,
+	size_t *read,
+	void *data) {
+	struct gz_stream *stream = (struct gz_stream *) data;
+	stream->strm.next_out = (Bytef *) buf;
+	stream->strm.avail_out = buf_len;
+	while (stream->strm.avail_out == buf_len) {
+		int code;
+		if (stream->strm.avail_in == 0) {
+			size_t avail_in;
+			if (!stream->source((char *) stream->buffer, STREAM_BUFFER_SIZE, &avail_in, stream->source_data)) {
+				*read = 0;
+				return false;
+			}
+			if (avail_in == 0) {
+				/* A file that ends part way through a stream is truncated. */
+				*read = 0;
+				return stream->stream_end;
+			}
+			stream->strm.next_in = stream->buffer;
+			stream->strm.avail_in = avail_in;
+		}
+		if (stream->stream_end) {
+			inflateReset(&stream->strm);
+			stream->stream_end = false;
+		}
+		code = inflate(&stream->strm, Z_NO_FLUSH);
+		if (code == Z_STREAM_END) {
+			stream->stream_end = true;
+			stream->streams++;
+		} else if (code == Z_DATA_ERROR && stream->streams > 0 && stream->strm.total_out == 0) {
+			/* Junk after the last stream, such as padding, is ignored, as gzip does. */
+			stream->strm.avail_in = 0;
+			stream->stream_end = true;
+		} else if (code != Z_OK && code != Z_BUF_ERROR) {
+			*read = 0;
+			return false;
+		}
+	}
+	*read = buf_len - stream->strm.avail_out;
 	return true;
 }
 
-static bool buff_read_bz2(
+static void gz_stream_destroy(
+	struct gz_stream *stream) {
+	inflateEnd(&stream->strm);
+	DESTROY_MEMBER(stream, source);
+	free(stream);
+}
+
+static PandaBufferRead gz_stream_open(
+	PandaBufferRead source,
+	void *source_data,
+	PandaDestroy source_destroy,
+	void **user_data,
+	PandaDestroy *destroy) {
+	struct gz_stream *stream = malloc(sizeof(struct gz_stream));
+	stream->strm.zalloc = Z_NULL;
+	stream->strm.zfree = Z_NULL;
+	stream->strm.opaque = Z_NULL;
+	stream->strm.next_in = Z_NULL;
+	stream->strm.avail_in = 0;
+	/* Adding 16 to the window size expects a gzip header rather than a zlib one. */
+	if (inflateInit2(&stream->strm, 15 + 16) != Z_OK) {
+		free(stream);
+		return NULL;
+	}
+	stream->stream_end = false;
+	stream->streams = 0;
+	stream->source = source;
+	stream->source_data = source_data;
+	stream->source_destroy = source_destroy;
+	*user_data = stream;
+	*destroy = (PandaDestroy) gz_stream_destroy;
+	return gz_stream_read;
+}
+
+struct bz2_stream {
+	bz_stream strm;
+	bool stream_end;
+	size_t streams;
+	 MANAGED_MEMBER(
+		PandaBufferRead,
+		source);
+	char buffer[STREAM_BUFFER_SIZE];
+};
+
+static bool bz2_stream_read(
 	char *buf,
 	size_t buf_len,
 	size_t *read,
 	void *data) {
-	BZFILE *file = (BZFILE *) data;
-	int bzerror;
-	*read = BZ2_bzRead(&bzerror, file, buf, buf_len);
-	return bzerror == BZ_OK || bzerror == BZ_STREAM_END;
+	struct bz2_stream *stream = (struct bz2_stream *) data;
+	stream->strm.next_out = buf;
+	stream->strm.avail_out = buf_len;
+	while (stream->strm.avail_out == buf_len) {
+		int code;
+		if (stream->strm.avail_in == 0) {
+			size_t avail_in;
+			if (!stream->source(stream->buffer, STREAM_BUFFER_SIZE, &avail_in, stream->source_data)) {
+				*read = 0;
+				return false;
+			}
+			if (avail_in == 0) {
+				*read = 0;
+				return stream->stream_end;
+			}
+			stream->strm.next_in = stream->buffer;
+			stream->strm.avail_in = avail_in;
+		}
+		if (stream->stream_end) {
+			/* There is no reset in bzip2, so start again, keeping the input. */
+			char *next_in = stream->strm.next_in;
+			unsigned int avail_in = stream->strm.avail_in;
+			BZ2_bzDecompressEnd(&stream->strm);
+			if (BZ2_bzDecompressInit(&stream->strm, 0, 0) != BZ_OK) {
+				*read = 0;
+				return false;
+			}
+			stream->strm.next_in = next_in;
+			stream->strm.avail_in = avail_in;
+			stream->stream_end = false;
+		}
+		code = BZ2_bzDecompress(&stream->strm);
+		if (code == BZ_STREAM_END) {
+			stream->stream_end = true;
+			stream->streams++;
+		} else if (code == BZ_DATA_ERROR_MAGIC && stream->streams > 0) {
+			stream->strm.avail_in = 0;
+			stream->stream_end = true;
+		} else if (code != BZ_OK) {
+			*read = 0;
+			return false;
+		}
+	}
+	*read = buf_len - stream->strm.avail_out;
+	return true;
 }
 
-PandaBufferRead panda_open_buffer(
+static void bz2_stream_destroy(
+	struct bz2_stream *stream) {
+	BZ2_bzDecompressEnd(&stream->strm);
+	DESTROY_MEMBER(stream, source);
+	free(stream);
+}
+
+static PandaBufferRead bz2_stream_open(
+	PandaBufferRead source,
+	void *source_data,
+	PandaDestroy source_destroy,
+	void **user_data,
+	PandaDestroy *destroy) {
+	struct bz2_stream *stream = malloc(sizeof(struct bz2_stream));
+	stream->strm.bzalloc = NULL;
+	stream->strm.bzfree = NULL;
+	stream->strm.opaque = NULL;
+	if (BZ2_bzDecompressInit(&stream->strm, 0, 0) != BZ_OK) {
+		free(stream);
+		return NULL;
+	}
+	stream->strm.next_in = NULL;
+	stream->strm.avail_in = 0;
+	stream->stream_end = false;
+	stream->streams = 0;
+	stream->source = source;
+	stream->source_data = source_data;
+	stream->source_destroy = source_destroy;
+	*user_data = stream;
+	*destroy = (PandaDestroy) bz2_stream_destroy;
+	return bz2_stream_read;
+}
+
+#ifdef HAVE_SYS_MMAN_H
+static bool mapped_file_read(
+	char *buf,
+	size_t buf_len,
+	size_t *read,
+	void *data) {
+	struct mapped_file *file = (struct mapped_file *) data;
+	*read = file->length - file->offset < buf_len ? file->length - file->offset : buf_len;
+	memcpy(buf, file->data + file->offset, *read);
+	file->offset += *read;
+	return true;
+}
+
+static void mapped_file_destroy(
+	struct mapped_file *file) {
+	munmap((void *) file->data, file->length);
+	free(file);
+}
+
+/* Map an uncompressed regular file into memory. Anything that can't be mapped, such as a pipe, is read as it arrives. */
+static struct mapped_file *mapped_file_open(
+	int fd) {
+	struct stat info;
+	struct mapped_file *file;
+	void *data;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0 || (unsigned long long) info.st_size > (size_t) -1) {
+		return NULL;
+	}
+	data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
+		return NULL;
+	}
+	posix_madvise(data, info.st_size, POSIX_MADV_SEQUENTIAL);
+	file = malloc(sizeof(struct mapped_file));
+	file->data = data;
+	file->length = info.st_size;
+	file->offset = 0;
+	return file;
+}
+#endif
+
+/* Open a file, as panda_open_buffer does. If the file is mapped into memory, the mapping is also stored in mapped. */
+static PandaBufferRead open_file(
 	const char *file_name,
 	PandaLogProxy logger,
+	struct mapped_file **mapped,
 	void **user_data,
 	PandaDestroy *destroy) {
-	char buffer[2];
+	struct fd_stream *stream;
+	PandaBufferRead read;
 	int fd;
+	*mapped = NULL;
 	*user_data = NULL;
 	*destroy = NULL;
 
-	fd = open(file_name, O_RDONLY);
-	if (fd < 0 || read(fd, &buffer, 2) != 2 || lseek(fd, 0, SEEK_SET) != 0) {
+	fd = strcmp(file_name, "-") == 0 ? STDIN_FILENO : open(file_name, O_RDONLY);
+	if (fd < 0) {
 		panda_log_proxy_write(logger, PANDA_CODE_NO_FILE, NULL, NULL, file_name);
 		return NULL;
 	}
-	if (buffer[0] == 'B' && buffer[1] == 'Z') {
-		BZFILE *bz_file;
-		bz_file = BZ2_bzdopen(fd, "r");
-		if (bz_file == NULL) {
+	stream = malloc(sizeof(struct fd_stream));
+	stream->fd = fd;
+	stream->peek_length = 0;
+	stream->peek_offset = 0;
+	/* Only a gzip file needs more than two bytes to tell what it is, so a slow pipe of plain text isn't kept waiting for a full BGZF header. */
+	while (stream->peek_length < 2 || (stream->peek_length < sizeof(stream->peek) && stream->peek[0] == '\x1F' && stream->peek[1] == '\x8B')) {
+		size_t length;
+		if (!fd_read(fd, stream->peek + stream->peek_length, sizeof(stream->peek) - stream->peek_length, &length) || (length == 0 && stream->peek_length < 2)) {
 			panda_log_proxy_write(logger, PANDA_CODE_NO_FILE, NULL, NULL, file_name);
-			close(fd);
+			fd_stream_destroy(stream);
 			return NULL;
 		}
-		*user_data = bz_file;
-		*destroy = BZ2_bzclose;
-		return buff_read_bz2;
+		if (length == 0) {
+			break;
+		}
+		stream->peek_length += length;
+	}
+	if (stream->peek[0] == 'B' && stream->peek[1] == 'Z') {
+		read = bz2_stream_open(fd_stream_read, stream, (PandaDestroy) fd_stream_destroy, user_data, destroy);
+	} else if (stream->peek[0] == '\x1F' && stream->peek[1] == '\x8B') {
+#ifdef HAVE_PTHREAD
+		if (bgzf_check_header(stream->peek, stream->peek_length) && (read = bgzf_open(fd_stream_read, stream, (PandaDestroy) fd_stream_destroy, user_data, destroy)) != NULL) {
+			return read;
+		}
+#endif
+		read = gz_stream_open(fd_stream_read, stream, (PandaDestroy) fd_stream_destroy, user_data, destroy);
 	} else {
-		gzFile gz_file;
-		gz_file = gzdopen(fd, "r");
-		if (gz_file == NULL) {
-			panda_log_proxy_write(logger, PANDA_CODE_NO_FILE, NULL, NULL, file_name);
-			close(fd);
-			return NULL;
+#ifdef HAVE_SYS_MMAN_H
+		if ((*mapped = mapped_file_open(fd)) != NULL) {
+			/* The mapping stays valid after the file is closed. */
+			fd_stream_destroy(stream);
+			*user_data = *mapped;
+			*destroy = (PandaDestroy) mapped_file_destroy;
+			return mapped_file_read;
 		}
-		*user_data = gz_file;
-		*destroy = (PandaDestroy) gzclose;
-		return buff_read_gz;
+#endif
+		*user_data = stream;
+		*destroy = (PandaDestroy) fd_stream_destroy;
+		return fd_stream_read;
+	}
+	if (read == NULL) {
+		panda_log_proxy_write(logger, PANDA_CODE_NO_FILE, NULL, NULL, file_name);
+		fd_stream_destroy(stream);
+		return NULL;
+	}
+#ifdef HAVE_PTHREAD
+	{
+		/* Other compressed files can only be decompressed in order, but that can happen ahead of the parser on another thread. */
+		void *ahead_data;
+		PandaDestroy ahead_destroy;
+		PandaBufferRead ahead = read_ahead_open(read, *user_data, *destroy, &ahead_data, &ahead_destroy);
+		if (ahead != NULL) {
+			*user_data = ahead_data;
+			*destroy = ahead_destroy;
+			return ahead;
+		}
+	}
+#endif
+	return read;
+}
+
+PandaBufferRead panda_open_buffer(
+	const char *file_name,
+	PandaLogProxy logger,
+	void **user_data,
+	PandaDestroy *destroy) {
+	struct mapped_file *mapped;
+	return open_file(file_name, logger, &mapped, user_data, destroy);
+}
+
+PandaLineBuf linebuf_open(
+	const char *file_name,
+	PandaLogProxy logger) {
+	struct mapped_file *mapped;
+	void *read_data;
+	PandaDestroy read_destroy;
+	PandaBufferRead read = open_file(file_name, logger, &mapped, &read_data, &read_destroy);
+	if (read == NULL) {
+		return NULL;
 	}
+	return mapped == NULL ? panda_linebuf_new(read, read_data, read_destroy) : linebuf_new_mapped(read, mapped, read_destroy);
 }
 
 PandaNextSeq panda_open_fastq(
@@ -106,34 +426,31 @@ PandaNextSeq panda_open_fastq(
 	const char *index,
 	void **user_data,
 	PandaDestroy *destroy) {
-	MANAGED_STACK(PandaBufferRead,
-		forward_file);
-	MANAGED_STACK(PandaBufferRead,
-		reverse_file);
-	MANAGED_STACK(PandaBufferRead,
-		index_file);
+	PandaLineBuf forward_file;
+	PandaLineBuf reverse_file;
+	PandaLineBuf index_file;
 
 	*user_data = NULL;
 	*destroy = NULL;
 
-	forward_file = panda_open_buffer(forward, logger, &forward_file_data, &forward_file_destroy);
+	forward_file = linebuf_open(forward, logger);
 	if (forward_file == NULL) {
 		return NULL;
 	}
 
-	reverse_file = panda_open_buffer(reverse, logger, &reverse_file_data, &reverse_file_destroy);
+	reverse_file = linebuf_open(reverse, logger);
 	if (reverse_file == NULL) {
-		DESTROY_STACK(forward_file);
+		panda_linebuf_free(forward_file);
 		return NULL;
 	}
-	index_file = index == NULL ? NULL : panda_open_buffer(index, logger, &index_file_data, &index_file_destroy);
+	index_file = index == NULL ? NULL : linebuf_open(index, logger);
 	if (index != NULL && index_file == NULL) {
-		DESTROY_STACK(forward_file);
-		DESTROY_STACK(reverse_file);
+		panda_linebuf_free(forward_file);
+		panda_linebuf_free(reverse_file);
 		return NULL;
 	}
 
-	return panda_create_fastq_reader(forward_file, forward_file_data, forward_file_destroy, reverse_file, reverse_file_data, reverse_file_destroy, logger, qualmin, policy, index_file, index_file_data, index_file_destroy, user_data, destroy);
+	return fastq_reader_new(forward_file, reverse_file, logger, qualmin, policy, index_file, user_data, destroy);
 }
 
 PandaAssembler panda_assembler_open_fastq(
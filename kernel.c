@@ -0,0 +1,411 @@
+/* PANDAseq -- Assemble paired FASTQ Illumina reads and strip the region between amplification primers.
+     Copyright (C) 2011-2013  Andre Masella
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+#include "config.h"
+#include <math.h>
+#include <stdlib.h>
+#include "pandaseq.h"
+#include "kernel.h"
+#include "prob.h"
+#if defined(HAVE_IMMINTRIN_H) && defined(__x86_64__) && defined(__GNUC__)
+#        define X86_KERNELS
+#        include <immintrin.h>
+#endif
+
+/* The number of interleaved partial sums. This matches the number of doubles in an AVX register and all kernels must use the same order of addition. */
+#define LANES OVERLAP_KERNEL_LANES
+#define FINISH_SUM(sums) (((sums)[0] + (sums)[1]) + ((sums)[2] + (sums)[3]))
+/* The number of bases scored between checks of whether an overlap can still win. It must be a multiple of LANES. */
+#define BOUND_CHUNK 16
+
+void overlap_table_init(
+	overlap_table *table,
+	const double match[][OVERLAP_TABLE_WIDTH],
+	const double mismatch[][OVERLAP_TABLE_WIDTH],
+	double offset,
+	bool unknown_is_special,
+	double unknown) {
+	size_t f;
+	size_t r;
+	for (f = 0; f < OVERLAP_TABLE_WIDTH; f++) {
+		for (r = 0; r < OVERLAP_TABLE_WIDTH; r++) {
+			table->scores[f * OVERLAP_TABLE_WIDTH + r] = match[f][r] - offset;
+			table->scores[OVERLAP_TABLE_MISMATCH + f * OVERLAP_TABLE_WIDTH + r] = mismatch[f][r] - offset;
+		}
+	}
+	table->unknown_is_special = unknown_is_special;
+	overlap_table_set_unknown(table, unknown);
+}
+
+void overlap_table_set_unknown(
+	overlap_table *table,
+	double unknown) {
+	size_t f;
+	size_t r;
+	table->scores[OVERLAP_TABLE_UNKNOWN] = unknown;
+	for (f = 0; f < OVERLAP_TABLE_WIDTH; f++) {
+		table->forward_max[f] = table->reverse_max[f] = table->unknown_is_special ? unknown : -INFINITY;
+	}
+	for (f = 0; f < OVERLAP_TABLE_WIDTH; f++) {
+		for (r = 0; r < OVERLAP_TABLE_WIDTH; r++) {
+			double best = fmax(table->scores[f * OVERLAP_TABLE_WIDTH + r], table->scores[OVERLAP_TABLE_MISMATCH + f * OVERLAP_TABLE_WIDTH + r]);
+			table->forward_max[f] = fmax(table->forward_max[f], best);
+			table->reverse_max[r] = fmax(table->reverse_max[r], best);
+		}
+	}
+}
+
+void overlap_reads_prepare(
+	overlap_reads *reads,
+	const panda_qual *forward,
+	size_t forward_length,
+	const panda_qual *reverse,
+	size_t reverse_length) {
+	read_arrays forward_arrays;
+	read_arrays reverse_arrays;
+	read_arrays_split(&forward_arrays, forward, forward_length);
+	read_arrays_split(&reverse_arrays, reverse, reverse_length);
+	overlap_reads_prepare_arrays(reads, &forward_arrays, &reverse_arrays);
+}
+
+void overlap_reads_prepare_arrays(
+	overlap_reads *reads,
+	const read_arrays *forward,
+	const read_arrays *reverse) {
+	size_t i;
+	reads->forward_length = forward->length;
+	reads->reverse_length = reverse->length;
+	for (i = 0; i < forward->length; i++) {
+		reads->forward_row[i] = PHREDCLAMP(forward->qual[i]) * OVERLAP_TABLE_WIDTH;
+		reads->forward_nt[i] = forward->nt[i];
+	}
+	for (i = 0; i < reverse->length; i++) {
+		reads->reverse_column[i] = PHREDCLAMP(reverse->qual[reverse->length - i - 1]);
+		reads->reverse_nt[i] = reverse->nt[reverse->length - i - 1];
+	}
+}
+
+void overlap_reads_bound(
+	overlap_reads *reads,
+	const overlap_table *table) {
+	size_t i;
+	reads->forward_bound[0] = 0;
+	for (i = 0; i < reads->forward_length; i++) {
+		reads->forward_bound[i + 1] = reads->forward_bound[i] + table->forward_max[reads->forward_row[i] / OVERLAP_TABLE_WIDTH];
+	}
+	reads->reverse_bound[0] = 0;
+	for (i = 0; i < reads->reverse_length; i++) {
+		reads->reverse_bound[i + 1] = reads->reverse_bound[i] + table->reverse_max[reads->reverse_column[i]];
+	}
+}
+
+static inline size_t score_index(
+	const overlap_table *table,
+	const overlap_reads *reads,
+	size_t f,
+	size_t r) {
+	if (table->unknown_is_special && (PANDA_NT_IS_N(reads->forward_nt[f]) || PANDA_NT_IS_N(reads->reverse_nt[r]))) {
+		return OVERLAP_TABLE_UNKNOWN;
+	}
+	return ((reads->forward_nt[f] & reads->reverse_nt[r]) == 0 ? OVERLAP_TABLE_MISMATCH : 0) + reads->forward_row[f] + reads->reverse_column[r];
+}
+
+static void overlap_scalar(
+	const overlap_table *table,
+	const overlap_reads *reads,
+	size_t forward_start,
+	size_t reverse_start,
+	size_t length,
+	double *sums) {
+	size_t i;
+
+	for (i = 0; i < length; i++) {
+		sums[i % LANES] += table->scores[score_index(table, reads, forward_start + i, reverse_start + i)];
+	}
+}
+
+static void split_scalar(
+	read_arrays *arrays,
+	const panda_qual *read,
+	size_t length) {
+	size_t i;
+	for (i = 0; i < length; i++) {
+		arrays->nt[i] = read[i].nt;
+		arrays->qual[i] = read[i].qual;
+	}
+}
+
+#ifdef X86_KERNELS
+/* Separate sixteen bases at a time. Shuffling the eight bases in a register puts the nucleotides in the low half and the scores in the high half, so two registers can be recombined into sixteen nucleotides and sixteen scores. */
+__attribute__ ((target("sse4.2")))
+static void split_sse42(
+	read_arrays *arrays,
+	const panda_qual *read,
+	size_t length) {
+	const __m128i order = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+	size_t i;
+	for (i = 0; i + 16 <= length; i += 16) {
+		__m128i low = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (read + i)), order);
+		__m128i high = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (read + i + 8)), order);
+		_mm_storeu_si128((__m128i *) (arrays->nt + i), _mm_unpacklo_epi64(low, high));
+		_mm_storeu_si128((__m128i *) (arrays->qual + i), _mm_unpackhi_epi64(low, high));
+	}
+	for (; i < length; i++) {
+		arrays->nt[i] = read[i].nt;
+		arrays->qual[i] = read[i].qual;
+	}
+}
+
+/* Compute the table indices for four bases. */
+__attribute__ ((target("sse4.2")))
+static inline __m128i decode_indices(
+	const overlap_table *table,
+	const overlap_reads *reads,
+	size_t f,
+	size_t r) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i fnt = _mm_loadu_si128((const __m128i *) (reads->forward_nt + f));
+	__m128i rnt = _mm_loadu_si128((const __m128i *) (reads->reverse_nt + r));
+	__m128i mismatch = _mm_cmpeq_epi32(_mm_and_si128(fnt, rnt), zero);
+	__m128i index = _mm_add_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i *) (reads->forward_row + f)), _mm_loadu_si128((const __m128i *) (reads->reverse_column + r))), _mm_and_si128(mismatch, _mm_set1_epi32(OVERLAP_TABLE_MISMATCH)));
+	if (table->unknown_is_special) {
+		const __m128i n = _mm_set1_epi32(0x0F);
+		__m128i unknown = _mm_or_si128(_mm_cmpeq_epi32(fnt, n), _mm_cmpeq_epi32(rnt, n));
+		index = _mm_blendv_epi8(index, _mm_set1_epi32(OVERLAP_TABLE_UNKNOWN), unknown);
+	}
+	return index;
+}
+
+__attribute__ ((target("sse4.2")))
+static void overlap_sse42(
+	const overlap_table *table,
+	const overlap_reads *reads,
+	size_t forward_start,
+	size_t reverse_start,
+	size_t length,
+	double *sums) {
+	/* There is no gather instruction, so the table lookups are done one at a time, but the index computation and the sums are still vectorised. Lanes 0 and 1 are in low and lanes 2 and 3 are in high. */
+	__m128d low = _mm_loadu_pd(sums);
+	__m128d high = _mm_loadu_pd(sums + 2);
+	size_t i;
+
+	for (i = 0; i + LANES <= length; i += LANES) {
+		int indices[LANES];
+		_mm_storeu_si128((__m128i *) indices, decode_indices(table, reads, forward_start + i, reverse_start + i));
+		low = _mm_add_pd(low, _mm_set_pd(table->scores[indices[1]], table->scores[indices[0]]));
+		high = _mm_add_pd(high, _mm_set_pd(table->scores[indices[3]], table->scores[indices[2]]));
+	}
+	_mm_storeu_pd(sums, low);
+	_mm_storeu_pd(sums + 2, high);
+	for (; i < length; i++) {
+		sums[i % LANES] += table->scores[score_index(table, reads, forward_start + i, reverse_start + i)];
+	}
+}
+
+__attribute__ ((target("avx2")))
+static void overlap_avx2(
+	const overlap_table *table,
+	const overlap_reads *reads,
+	size_t forward_start,
+	size_t reverse_start,
+	size_t length,
+	double *sums) {
+	__m256d sum = _mm256_loadu_pd(sums);
+	size_t i;
+
+	for (i = 0; i + LANES <= length; i += LANES) {
+		sum = _mm256_add_pd(sum, _mm256_i32gather_pd(table->scores, decode_indices(table, reads, forward_start + i, reverse_start + i), sizeof(double)));
+	}
+	_mm256_storeu_pd(sums, sum);
+	for (; i < length; i++) {
+		sums[i % LANES] += table->scores[score_index(table, reads, forward_start + i, reverse_start + i)];
+	}
+}
+#endif
+
+overlap_kernel overlap_kernel_get(
+	overlap_kernel_level level) {
+	switch (level) {
+	case OVERLAP_KERNEL_SCALAR:
+		return overlap_scalar;
+#ifdef X86_KERNELS
+	case OVERLAP_KERNEL_SSE42:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse4.2") ? overlap_sse42 : NULL;
+	case OVERLAP_KERNEL_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? overlap_avx2 : NULL;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+static overlap_kernel best_kernel = overlap_scalar;
+static void (
+	*best_split) (
+	read_arrays *arrays,
+	const panda_qual *read,
+	size_t length) = split_scalar;
+
+__attribute__ ((constructor))
+static void kernel_init(
+	void) {
+	overlap_kernel_level level;
+#ifdef X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse4.2")) {
+		best_split = split_sse42;
+	}
+#endif
+	for (level = OVERLAP_KERNEL_AVX2; level > OVERLAP_KERNEL_SCALAR; level--) {
+		overlap_kernel kernel = overlap_kernel_get(level);
+		if (kernel != NULL) {
+			best_kernel = kernel;
+			return;
+		}
+	}
+}
+
+void read_arrays_split(
+	read_arrays *arrays,
+	const panda_qual *read,
+	size_t length) {
+	arrays->length = length;
+	best_split(arrays, read, length);
+}
+
+/* Only the part of the overlap where both reads have bases counts. In the reversed reverse read, this is [start, end). */
+#define OVERLAP_START(reads, overlap) ((overlap) > (reads)->forward_length ? (overlap) - (reads)->forward_length : 0)
+#define OVERLAP_END(reads, overlap) ((overlap) < (reads)->reverse_length ? (overlap) : (reads)->reverse_length)
+
+double overlap_reads_score(
+	overlap_kernel kernel,
+	const overlap_table *table,
+	const overlap_reads *reads,
+	size_t overlap) {
+	size_t start = OVERLAP_START(reads, overlap);
+	size_t end = OVERLAP_END(reads, overlap);
+	double sums[LANES] = { 0, 0, 0, 0 };
+	if (end <= start) {
+		return 0;
+	}
+	kernel(table, reads, reads->forward_length + start - overlap, start, end - start, sums);
+	return FINISH_SUM(sums);
+}
+
+/* The best score bases [start, end) of the reversed reverse read could have, in the supplied overlap. */
+static inline double score_bound(
+	const overlap_reads *reads,
+	size_t overlap,
+	size_t start,
+	size_t end) {
+	size_t forward_start = reads->forward_length + start - overlap;
+	return fmin(reads->forward_bound[forward_start + end - start] - reads->forward_bound[forward_start], reads->reverse_bound[end] - reads->reverse_bound[start]);
+}
+
+/* Check if an overlap whose score is at most bound cannot beat the best one. The bounds are computed with a different order of addition from the real score, so allow a margin far larger than any rounding error. */
+static inline bool cannot_win(
+	double bound,
+	double best_probability) {
+	return bound + 1e-6 * (1 + fabs(bound) + fabs(best_probability)) < best_probability;
+}
+
+/* Score an overlap in chunks, giving up if it cannot beat the best. Returns false if the overlap was abandoned. */
+static bool score_bounded(
+	const overlap_table *table,
+	const overlap_reads *reads,
+	size_t overlap,
+	double best_probability,
+	double *probability) {
+	size_t start = OVERLAP_START(reads, overlap);
+	size_t end = OVERLAP_END(reads, overlap);
+	size_t forward_start;
+	double sums[LANES] = { 0, 0, 0, 0 };
+	size_t i;
+	if (end <= start) {
+		*probability = 0;
+		return true;
+	}
+	if (cannot_win(score_bound(reads, overlap, start, end), best_probability)) {
+		return false;
+	}
+	forward_start = reads->forward_length + start - overlap;
+	for (i = start; i + BOUND_CHUNK < end; i += BOUND_CHUNK) {
+		best_kernel(table, reads, forward_start + i - start, i, BOUND_CHUNK, sums);
+		if (cannot_win(FINISH_SUM(sums) + score_bound(reads, overlap, i + BOUND_CHUNK, end), best_probability)) {
+			return false;
+		}
+	}
+	best_kernel(table, reads, forward_start + i - start, i, end - i, sums);
+	*probability = FINISH_SUM(sums);
+	return true;
+}
+
+double overlap_table_probability(
+	const overlap_table *table,
+	const panda_qual *forward,
+	size_t forward_length,
+	const panda_qual *reverse,
+	size_t reverse_length,
+	size_t overlap) {
+	overlap_reads reads;
+	overlap_reads_prepare(&reads, forward, forward_length, reverse, reverse_length);
+	return overlap_reads_score(best_kernel, table, &reads, overlap);
+}
+
+ptrdiff_t overlap_table_best(
+	const overlap_table *table,
+	const panda_qual *forward,
+	size_t forward_length,
+	const panda_qual *reverse,
+	size_t reverse_length,
+	const size_t *overlaps,
+	size_t overlaps_length,
+	double *best_probability,
+	double *probabilities) {
+	overlap_reads reads;
+	overlap_reads_prepare(&reads, forward, forward_length, reverse, reverse_length);
+	if (probabilities == NULL) {
+		overlap_reads_bound(&reads, table);
+	}
+	return overlap_reads_best(table, &reads, overlaps, overlaps_length, best_probability, probabilities);
+}
+
+ptrdiff_t overlap_reads_best(
+	const overlap_table *table,
+	const overlap_reads *reads,
+	const size_t *overlaps,
+	size_t overlaps_length,
+	double *best_probability,
+	double *probabilities) {
+	ptrdiff_t best_overlap = -1;
+	size_t it;
+	for (it = 0; it < overlaps_length; it++) {
+		double probability;
+		if (probabilities != NULL) {
+			probabilities[it] = probability = overlap_reads_score(best_kernel, table, reads, overlaps[it]);
+		} else if (!score_bounded(table, reads, overlaps[it], *best_probability, &probability)) {
+			continue;
+		}
+		if (probability > *best_probability || (probability == *best_probability && best_overlap != -1 && overlaps[it] < (size_t) best_overlap)) {
+			*best_probability = probability;
+			best_overlap = overlaps[it];
+		}
+	}
+	return best_overlap;
+}
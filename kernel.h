@@ -0,0 +1,186 @@
+/* PANDAseq -- Assemble paired FASTQ Illumina reads and strip the region between amplification primers.
+     Copyright (C) 2011-2013  Andre Masella
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+#ifndef KERNEL_H
+#        define KERNEL_H
+#        include <stddef.h>
+#        include <stdint.h>
+#        include "config.h"
+#        include "pandaseq.h"
+#        include "prob.h"
+
+#        define OVERLAP_TABLE_WIDTH (PHREDMAX + 1)
+#        define OVERLAP_TABLE_MISMATCH (OVERLAP_TABLE_WIDTH * OVERLAP_TABLE_WIDTH)
+#        define OVERLAP_TABLE_UNKNOWN (2 * OVERLAP_TABLE_MISMATCH)
+
+/*
+ * The score of every pair of bases for algorithms where the overlap probability is the sum of a per-base score looked up by the PHRED scores of both bases.
+ *
+ * The match scores are first, then the mismatch scores, then a single score used when either base is an N, if the algorithm treats those specially. Any constant offset is subtracted when the table is built, so scoring a base is a single load.
+ */
+typedef struct {
+	double scores[OVERLAP_TABLE_UNKNOWN + 1];
+	bool unknown_is_special;
+	/* The best score a base with a particular PHRED score can contribute, whatever it is paired with. */
+	double forward_max[OVERLAP_TABLE_WIDTH];
+	double reverse_max[OVERLAP_TABLE_WIDTH];
+} overlap_table;
+
+void overlap_table_init(
+	overlap_table *table,
+	const double match[][OVERLAP_TABLE_WIDTH],
+	const double mismatch[][OVERLAP_TABLE_WIDTH],
+	double offset,
+	bool unknown_is_special,
+	double unknown);
+
+/*
+ * Change the score used when either base is an N.
+ */
+void overlap_table_set_unknown(
+	overlap_table *table,
+	double unknown);
+
+/*
+ * A read with its nucleotides and quality scores in separate arrays, rather than interleaved as in panda_qual, so consecutive bases can be loaded into a vector register directly.
+ */
+typedef struct {
+	panda_nt nt[MAX_LEN];
+	char qual[MAX_LEN];
+	size_t length;
+} read_arrays;
+
+/*
+ * Separate the nucleotides and quality scores of a read using the best instructions available on this processor.
+ */
+void read_arrays_split(
+	read_arrays *arrays,
+	const panda_qual *read,
+	size_t length);
+
+/*
+ * The bases of a pair of reads, decoded for table lookups. Every array holds one 32-bit value per base so four bases can be processed in a vector register. The reverse read is stored back-to-front, so position i of the overlap is at the same offset in both reads.
+ */
+typedef struct {
+	int32_t forward_row[MAX_LEN];
+	int32_t forward_nt[MAX_LEN];
+	int32_t reverse_column[MAX_LEN];
+	int32_t reverse_nt[MAX_LEN];
+	size_t forward_length;
+	size_t reverse_length;
+	/* Running totals of the best score each base could contribute, filled by overlap_reads_bound. The upper bound on the score of bases [a, b) is the difference between entries b and a. */
+	double forward_bound[MAX_LEN + 1];
+	double reverse_bound[MAX_LEN + 1];
+} overlap_reads;
+
+void overlap_reads_prepare(
+	overlap_reads *reads,
+	const panda_qual *forward,
+	size_t forward_length,
+	const panda_qual *reverse,
+	size_t reverse_length);
+
+/*
+ * Decode a pair of reads that have already been separated.
+ */
+void overlap_reads_prepare_arrays(
+	overlap_reads *reads,
+	const read_arrays *forward,
+	const read_arrays *reverse);
+
+/*
+ * Compute the upper bounds on the scores of the decoded reads.
+ */
+void overlap_reads_bound(
+	overlap_reads *reads,
+	const overlap_table *table);
+
+#        define OVERLAP_KERNEL_LANES 4
+
+/*
+ * A kernel adds the table scores of the supplied number of bases starting at the provided position in both decoded reads to the partial sums.
+ *
+ * Base i goes into partial sum i % OVERLAP_KERNEL_LANES and the partial sums are added pairwise at the end, so every kernel gives bit-identical results. This is not the order in which the bases were added before the kernels, so an overlap's probability may differ from that in the last bits. A long overlap can be summed in several calls, as long as every call but the last covers a multiple of OVERLAP_KERNEL_LANES bases.
+ */
+typedef void (
+	*overlap_kernel) (
+	const overlap_table *table,
+	const overlap_reads *reads,
+	size_t forward_start,
+	size_t reverse_start,
+	size_t length,
+	double *sums);
+
+typedef enum {
+	OVERLAP_KERNEL_SCALAR,
+	OVERLAP_KERNEL_SSE42,
+	OVERLAP_KERNEL_AVX2,
+} overlap_kernel_level;
+
+/*
+ * Get the kernel for a particular instruction set. Returns NULL if the processor or the build does not support it.
+ */
+overlap_kernel overlap_kernel_get(
+	overlap_kernel_level level);
+
+/*
+ * Compute the probability of a single overlap using the supplied kernel.
+ */
+double overlap_reads_score(
+	overlap_kernel kernel,
+	const overlap_table *table,
+	const overlap_reads *reads,
+	size_t overlap);
+
+/*
+ * Compute the overlap probability using the best kernel available on this processor.
+ */
+double overlap_table_probability(
+	const overlap_table *table,
+	const panda_qual *forward,
+	size_t forward_length,
+	const panda_qual *reverse,
+	size_t reverse_length,
+	size_t overlap);
+
+/*
+ * Find the best of many overlaps of decoded reads using the best kernel available on this processor. Unless the probability of every overlap is requested, the bounds must have been computed by overlap_reads_bound.
+ */
+ptrdiff_t overlap_reads_best(
+	const overlap_table *table,
+	const overlap_reads *reads,
+	const size_t *overlaps,
+	size_t overlaps_length,
+	double *best_probability,
+	double *probabilities);
+
+/*
+ * Find the best of many overlaps using the best kernel available on this processor. The reads are only decoded once. This is suitable for use as a #PandaComputeOverlapBatch.
+ *
+ * Unless the probability of every overlap is requested, an overlap is abandoned as soon as the bases scored so far plus the best the remaining bases could add cannot beat the best overlap found. Placing the most likely overlaps first makes this more effective, but the chosen overlap does not depend on the order.
+ */
+ptrdiff_t overlap_table_best(
+	const overlap_table *table,
+	const panda_qual *forward,
+	size_t forward_length,
+	const panda_qual *reverse,
+	size_t reverse_length,
+	const size_t *overlaps,
+	size_t overlaps_length,
+	double *best_probability,
+	double *probabilities);
+#endif
@@ -0,0 +1,68 @@
+/* PANDAseq -- Assemble paired FASTQ Illumina reads and strip the region between amplification primers.
+     Copyright (C) 2011-2013  Andre Masella
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include "kmerindex.h"
+
+/* Keep the table at most a quarter full so that most probes for k-mers that are absent hit an empty slot immediately. */
+static size_t slots_for_length(
+	size_t length) {
+	size_t capacity = 16;
+	while (capacity < 4 * length) {
+		capacity <<= 1;
+	}
+	return capacity;
+}
+
+bool kmer_index_init(
+	kmer_index *index,
+	size_t num_kmers) {
+	index->num_kmers = num_kmers;
+	index->capacity = slots_for_length(MAX_LEN);
+	index->mask = index->capacity - 1;
+	index->epoch = 0;
+	index->keys = calloc(index->capacity, sizeof(uint64_t));
+	index->counts = calloc(index->capacity, sizeof(seqindex));
+	index->positions = malloc(index->capacity * (num_kmers > 0 ? num_kmers : 1) * sizeof(seqindex));
+	if (index->keys == NULL || index->counts == NULL || index->positions == NULL) {
+		kmer_index_cleanup(index);
+		return false;
+	}
+	return true;
+}
+
+void kmer_index_cleanup(
+	kmer_index *index) {
+	free0(index->keys);
+	free0(index->counts);
+	free0(index->positions);
+}
+
+void kmer_index_reset(
+	kmer_index *index,
+	size_t length) {
+	size_t capacity = slots_for_length(length);
+	index->mask = (capacity < index->capacity ? capacity : index->capacity) - 1;
+	index->epoch += (uint64_t) 1 << 32;
+	if (index->epoch == 0) {
+		/* After four billion reads, the read numbers wrap around and old slots could look current, so actually clear the table. */
+		memset(index->keys, 0, index->capacity * sizeof(uint64_t));
+		index->epoch = (uint64_t) 1 << 32;
+	}
+}
@@ -0,0 +1,109 @@
+/* PANDAseq -- Assemble paired FASTQ Illumina reads and strip the region between amplification primers.
+     Copyright (C) 2011-2013  Andre Masella
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+#ifndef KMERINDEX_H
+#        define KMERINDEX_H
+#        include <stdbool.h>
+#        include <stddef.h>
+#        include <stdint.h>
+#        include "config.h"
+#        include "misc.h"
+
+#        define KMER_INDEX_EPOCH_MASK (~(uint64_t) UINT32_MAX)
+
+/*
+ * The positions of the k-mers in a single read, stored in an open-addressing hash table.
+ *
+ * The table is sized for a single read rather than for every possible k-mer, so it stays in cache. Each key holds the number of the read it was stored for in the upper 32 bits and the k-mer in the lower 32 bits, so starting a new read does not need to clear the table and checking a slot is a single comparison.
+ */
+typedef struct {
+	uint64_t *keys;
+	seqindex *counts;
+	seqindex *positions;
+	size_t num_kmers;
+	size_t capacity;
+	size_t mask;
+	uint64_t epoch;
+} kmer_index;
+
+/*
+ * Allocate an index able to store num_kmers positions for every k-mer in a read of up to MAX_LEN bases.
+ */
+bool kmer_index_init(
+	kmer_index *index,
+	size_t num_kmers);
+
+void kmer_index_cleanup(
+	kmer_index *index);
+
+/*
+ * Discard the contents of the index and prepare to store the k-mers of a read of the supplied length.
+ */
+void kmer_index_reset(
+	kmer_index *index,
+	size_t length);
+
+/*
+ * Find the slot holding a key or, if it is absent, the empty slot where it belongs.
+ */
+static inline size_t kmer_index_slot(
+	const kmer_index *index,
+	uint64_t key) {
+	/* Fibonacci hashing spreads the k-mers, which differ mostly in their low bits, over the whole table. */
+	size_t slot = (size_t) (((uint32_t) key * UINT32_C(2654435769)) >> 16) & index->mask;
+	while ((index->keys[slot] & KMER_INDEX_EPOCH_MASK) == index->epoch && index->keys[slot] != key) {
+		slot = (slot + 1) & index->mask;
+	}
+	return slot;
+}
+
+/*
+ * Record a position for a k-mer. Returns false if the k-mer already has num_kmers positions, in which case the position is lost.
+ */
+static inline bool kmer_index_add(
+	kmer_index *index,
+	size_t kmer,
+	seqindex position) {
+	uint64_t key = index->epoch | kmer;
+	size_t slot = kmer_index_slot(index, key);
+	if (index->keys[slot] != key) {
+		index->keys[slot] = key;
+		index->counts[slot] = 0;
+	}
+	if (index->counts[slot] >= index->num_kmers) {
+		return false;
+	}
+	index->positions[slot * index->num_kmers + index->counts[slot]++] = position;
+	return true;
+}
+
+/*
+ * Find the positions recorded for a k-mer. Returns the number of positions and stores a pointer to them in positions.
+ */
+static inline size_t kmer_index_find(
+	const kmer_index *index,
+	size_t kmer,
+	const seqindex **positions) {
+	uint64_t key = index->epoch | kmer;
+	size_t slot = kmer_index_slot(index, key);
+	if (index->keys[slot] != key) {
+		return 0;
+	}
+	*positions = index->positions + slot * index->num_kmers;
+	return index->counts[slot];
+}
+#endif
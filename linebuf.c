@@ -21,31 +21,55 @@
 #include "pandaseq.h"
 #include "misc.h"
 
+/* Lines are handed out where they were read, so only the partial line at the end of each block is ever moved. A line must fit in the buffer. */
+#define LINEBUF_SIZE (256 * 1024)
+
 struct panda_linebuf {
-	char data[10 * MAX_LEN];
+	/* There is room for a terminator after the last line, even if it fills the buffer and has no newline. */
+	char data[LINEBUF_SIZE + 1];
 	size_t data_length;
 	size_t offset;
+	bool eof;
+	/* If reading from a mapped file, lines come straight from it and the buffer is only used to terminate them. */
+	struct mapped_file *mapped;
 	 MANAGED_MEMBER(
 		PandaBufferRead,
 		read);
 };
 
-PandaLineBuf panda_linebuf_new(
+static PandaLineBuf linebuf_new(
 	PandaBufferRead read,
 	void *read_data,
-	PandaDestroy read_destroy) {
+	PandaDestroy read_destroy,
+	struct mapped_file *mapped) {
 	PandaLineBuf buffer;
 	if (read == NULL)
 		return NULL;
 	buffer = malloc(sizeof(struct panda_linebuf));
 	buffer->data_length = 0;
 	buffer->offset = 0;
+	buffer->eof = false;
+	buffer->mapped = mapped;
 	buffer->read = read;
 	buffer->read_data = read_data;
 	buffer->read_destroy = read_destroy;
 	return buffer;
 }
 
+PandaLineBuf panda_linebuf_new(
+	PandaBufferRead read,
+	void *read_data,
+	PandaDestroy read_destroy) {
+	return linebuf_new(read, read_data, read_destroy, NULL);
+}
+
+PandaLineBuf linebuf_new_mapped(
+	PandaBufferRead read,
+	struct mapped_file *mapped,
+	PandaDestroy read_destroy) {
+	return linebuf_new(read, mapped, read_destroy, mapped);
+}
+
 void panda_linebuf_free(
 	PandaLineBuf linebuf) {
 	if (linebuf == NULL)
@@ -54,36 +78,88 @@ void panda_linebuf_free(
 	free(linebuf);
 }
 
-const char *panda_linebuf_next(
-	PandaLineBuf linebuf) {
+static char *next_in_buffer(
+	PandaLineBuf linebuf,
+	size_t *length) {
+	char *start;
 	char *end;
-	if (linebuf->offset > 0) {
-		memmove(linebuf->data, linebuf->data + linebuf->offset, linebuf->data_length - linebuf->offset);
-		linebuf->data_length -= linebuf->offset;
-		linebuf->offset = 0;
-	}
-
-	while ((end = memchr(linebuf->data, '\n', linebuf->data_length)) == NULL && linebuf->data_length < sizeof(linebuf->data)) {
+	while (linebuf->offset >= linebuf->data_length || (end = memchr(linebuf->data + linebuf->offset, '\n', linebuf->data_length - linebuf->offset)) == NULL) {
 		size_t new_bytes = 0;
-		if (!linebuf->read(linebuf->data + linebuf->data_length, sizeof(linebuf->data) - linebuf->data_length, &new_bytes, linebuf->read_data)) {
+		if (linebuf->eof) {
+			if (linebuf->offset >= linebuf->data_length) {
+				return NULL;
+			}
+			/* The last line has no newline. */
+			end = linebuf->data + linebuf->data_length;
+			break;
+		}
+		if (linebuf->offset > 0) {
+			memmove(linebuf->data, linebuf->data + linebuf->offset, linebuf->data_length - linebuf->offset);
+			linebuf->data_length -= linebuf->offset;
+			linebuf->offset = 0;
+		}
+		if (linebuf->data_length == LINEBUF_SIZE) {
 			return NULL;
 		}
-		if (new_bytes == 0) {
-			end = linebuf->data + linebuf->data_length + 1;
-			break;
+		if (!linebuf->read(linebuf->data + linebuf->data_length, LINEBUF_SIZE - linebuf->data_length, &new_bytes, linebuf->read_data)) {
+			return NULL;
 		}
+		linebuf->eof = new_bytes == 0;
 		linebuf->data_length += new_bytes;
 	}
-	if (end == NULL || linebuf->data_length == 0 || *end == '\0') {
-		return NULL;
-	}
+	start = linebuf->data + linebuf->offset;
+	linebuf->offset = end - linebuf->data + 1;
 
 	/* White out any carriage returns if we get DOS-formatted files. */
-	if (end != linebuf->data && end[-1] == '\r') {
+	if (end != start && end[-1] == '\r') {
 		end[-1] = '\0';
+		*length = end - start - 1;
+	} else {
+		*length = end - start;
 	}
 
 	*end = '\0';
-	linebuf->offset = end - linebuf->data + 1;
+	return start;
+}
+
+static const char *next_in_mapping(
+	struct mapped_file *mapped,
+	size_t *length) {
+	const char *start = mapped->data + mapped->offset;
+	const char *end;
+	if (mapped->offset >= mapped->length) {
+		return NULL;
+	}
+	end = memchr(start, '\n', mapped->length - mapped->offset);
+	if (end == NULL) {
+		/* The last line has no newline. */
+		end = mapped->data + mapped->length;
+	}
+	mapped->offset = end - mapped->data + 1;
+	*length = end - start;
+	if (end != start && end[-1] == '\r') {
+		(*length)--;
+	}
+	return start;
+}
+
+const char *panda_linebuf_next(
+	PandaLineBuf linebuf) {
+	const char *line;
+	size_t length;
+	if (linebuf->mapped == NULL) {
+		return next_in_buffer(linebuf, &length);
+	}
+	if ((line = next_in_mapping(linebuf->mapped, &length)) == NULL || length > LINEBUF_SIZE) {
+		return NULL;
+	}
+	memcpy(linebuf->data, line, length);
+	linebuf->data[length] = '\0';
 	return linebuf->data;
 }
+
+const char *panda_linebuf_next_length(
+	PandaLineBuf linebuf,
+	size_t *length) {
+	return linebuf->mapped == NULL ? next_in_buffer(linebuf, length) : next_in_mapping(linebuf->mapped, length);
+}
@@ -40,6 +40,8 @@ int main(
 		return 1;
 	}
 	free(general_args);
+	/* The FASTA and FASTQ writers only need the PHRED scores. */
+	panda_assembler_set_compact_results(assembler, true);
 	result = panda_run_pool(threads, assembler, mux, output, output_data, output_destroy);
 	panda_args_hang_free(data);
 	return result ? 0 : 1;
@@ -33,6 +33,8 @@ int main(
 		panda_args_fastq_free(data);
 		return 1;
 	}
+	/* The FASTA and FASTQ writers only need the PHRED scores. */
+	panda_assembler_set_compact_results(assembler, true);
 	result = panda_run_pool(threads, assembler, mux, output, output_data, output_destroy);
 	panda_args_fastq_free(data);
 	return result ? 0 : 1;
@@ -29,18 +29,43 @@
 #        define MAYBE(x) if (x != NULL) *x
 #        define free0(val) if ((val) != NULL) free(val); (val) = NULL
 
+/* An uncompressed file mapped into memory. A line buffer made for it hands out lines from the mapping rather than copying them. */
+struct mapped_file {
+	const char *data;
+	size_t length;
+	size_t offset;
+};
+/* Create a line buffer that takes lines directly from a mapped file. The reader must read the same file and is only kept so it can be destroyed along with the mapping. */
+PandaLineBuf linebuf_new_mapped(
+	PandaBufferRead read,
+	struct mapped_file *mapped,
+	PandaDestroy read_destroy);
+/* Open a file, as panda_open_buffer does, as a line buffer, using the mapping directly if the file could be mapped. */
+PandaLineBuf linebuf_open(
+	const char *file_name,
+	PandaLogProxy logger);
+/* Create a FASTQ reader from line buffers, as panda_create_fastq_reader does. The index may be NULL. */
+PandaNextSeq fastq_reader_new(
+	PandaLineBuf forward,
+	PandaLineBuf reverse,
+	PandaLogProxy logger,
+	unsigned char qualmin,
+	PandaTagging policy,
+	PandaLineBuf index,
+	void **user_data,
+	PandaDestroy *destroy);
 typedef unsigned short seqindex;
-#        define KMER_LEN ((size_t) 8)
-#        define KMERSEEN_SIZE(num_kmers) (sizeof(seqindex) * (num_kmers) * (1 << (2 * KMER_LEN)))
+#        define KMER_LEN ((size_t) PANDA_DEFAULT_KMER_LENGTH)
 
 typedef struct {
 	size_t kmer;
 	ptrdiff_t posn;
 	ptrdiff_t bad;
 } kmer_it;
-#        define _FOREACH_KMER(iterator,sequence,suffix,start,badstart,check,step,badreset) for ((iterator).posn = (start), (iterator).kmer = 0, (iterator).bad = badstart; (iterator).posn check; (iterator).posn step) if ((iterator).kmer = (((iterator).kmer << 2) | ((sequence)[(iterator).posn]suffix == PANDA_NT_T ? 3 : (sequence)[(iterator).posn]suffix == PANDA_NT_G ? 2 : (sequence)[(iterator).posn]suffix == PANDA_NT_C ? 1 : 0)) & ((1 << (2 * badreset)) - 1), PANDA_NT_IS_N((sequence)[(iterator).posn]suffix)) { (iterator).bad = badreset; } else if ((iterator).bad > 0) { (iterator).bad--; } else
-#        define FOREACH_KMER(iterator,sequence,suffix) _FOREACH_KMER(iterator, sequence, suffix, 0, KMER_LEN, < (ptrdiff_t)sequence ## _length, ++, KMER_LEN)
-#        define FOREACH_KMER_REVERSE(iterator,sequence,suffix) _FOREACH_KMER(iterator, sequence, suffix, sequence ## _length - 1, KMER_LEN, >= 0, --, KMER_LEN)
+#        define KMER_MASK(k) ((size_t) (k) >= 4 * sizeof(size_t) ? ~(size_t) 0 : ((size_t) 1 << (2 * (k))) - 1)
+#        define _FOREACH_KMER(iterator,sequence,suffix,start,badstart,check,step,badreset) for ((iterator).posn = (start), (iterator).kmer = 0, (iterator).bad = badstart; (iterator).posn check; (iterator).posn step) if ((iterator).kmer = (((iterator).kmer << 2) | ((sequence)[(iterator).posn]suffix == PANDA_NT_T ? 3 : (sequence)[(iterator).posn]suffix == PANDA_NT_G ? 2 : (sequence)[(iterator).posn]suffix == PANDA_NT_C ? 1 : 0)) & KMER_MASK(badreset), PANDA_NT_IS_N((sequence)[(iterator).posn]suffix)) { (iterator).bad = badreset; } else if ((iterator).bad > 0) { (iterator).bad--; } else
+#        define FOREACH_KMER(iterator,sequence,suffix,k) _FOREACH_KMER(iterator, sequence, suffix, 0, k, < (ptrdiff_t)sequence ## _length, ++, k)
+#        define FOREACH_KMER_REVERSE(iterator,sequence,suffix,k) _FOREACH_KMER(iterator, sequence, suffix, sequence ## _length - 1, k, >= 0, --, k)
 #        define KMER(kmerit) ((kmerit).kmer)
 #        define KMER_POSITION(kmerit) ((kmerit).posn)
 
@@ -27,6 +27,7 @@
 #include "pandaseq.h"
 #include "assembler.h"
 #include "buffer.h"
+#include "module.h"
 
 #define STR0(x) #x
 #define STR(x) STR0(x)
@@ -94,6 +95,7 @@ struct panda_module {
 
 	int api;
 	char **version;
+	bool uses_sequence;
 };
 
 void module_destroy(
@@ -105,6 +107,7 @@ void module_destroy(
 		panda_module_unref(assembler->modules[it]);
 	}
 	assembler->modules_length = 0;
+	assembler->sequence_modules = 0;
 	free(assembler->modules);
 }
 
@@ -172,6 +175,9 @@ bool panda_assembler_add_module(
 		assembler->rejected = realloc(assembler->rejected, assembler->modules_size * sizeof(size_t));
 	}
 	assembler->rejected[assembler->modules_length] = 0;
+	if (module->check != NULL && module->uses_sequence) {
+		assembler->sequence_modules++;
+	}
 	assembler->modules[assembler->modules_length++] = panda_module_ref(module);
 #ifdef HAVE_PTHREAD
 	pthread_mutex_unlock(&assembler->mutex);
@@ -288,6 +294,7 @@ PandaModule panda_module_load(
 		m->user_data = user_data;
 		m->destroy = destroy;
 		m->version = lt_dlsym(handle, "version");
+		m->uses_sequence = true;
 
 		return m;
 	} else {
@@ -317,6 +324,7 @@ PandaModule panda_module_new(
 	m->refcnt = 1;
 	m->user_data = user_data;
 	m->version = NULL;
+	m->uses_sequence = true;
 	return m;
 }
 
@@ -390,6 +398,17 @@ const char *panda_module_get_usage(
 	return val == NULL ? NULL : *val;
 }
 
+bool panda_module_get_uses_sequence(
+	PandaModule module) {
+	return module->uses_sequence;
+}
+
+void panda_module_set_uses_sequence(
+	PandaModule module,
+	bool uses_sequence) {
+	module->uses_sequence = uses_sequence;
+}
+
 static int show_module(
 	const char *filename,
 	void *data) {
@@ -33,7 +33,7 @@ extern void module_help(
 	PandaAssembler assembler);
 extern void module_version(
 	PandaAssembler assembler);
-extern bool module_init(
+extern void module_init(
 	PandaAssembler assembler);
 extern void module_cleanup(
 	PandaAssembler assembler);
@@ -16,12 +16,16 @@
 
  */
 #include "config.h"
+#include <assert.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include "pandaseq.h"
+#include "offset.h"
 #include "prob.h"
 #include "table.h"
 
@@ -29,8 +33,6 @@
 #        define M_LN2 0.69314718055994530942
 #endif
 
-#define CIRC(index, len) (((index) + (len)) % (len))
-
 /* Compute 1-exp(p) See <http://cran.r-project.org/web/packages/Rmpfr/vignettes/log1mexp-note.pdf> */
 double panda_log1mexp(
 	double p) {
@@ -44,49 +46,299 @@ typedef void (
 	double *prob,
 	double *notprob);
 
-static size_t computeoffset(
-	double threshold,
+/* The number of bit planes in the mismatch counters. Counts saturate at 2^PLANES - 1, which only makes the bound on an alignment's score looser. */
+#define PLANES 4
+
+/* Get the 64 bits starting at an arbitrary bit position. */
+static inline uint64_t window(
+	const uint64_t *words,
+	size_t start) {
+	size_t word = start / 64;
+	size_t shift = start % 64;
+	return shift == 0 ? words[word] : (words[word] >> shift) | (words[word + 1] << (64 - shift));
+}
+
+/* Find which of a block of 64 alignments have more mismatches, as counted in bit planes, than the limit, which must be less than the largest count. */
+static inline uint64_t more_mismatches(
+	uint64_t mismatches[][OFFSET_WORDS],
+	size_t word,
+	size_t limit) {
+	uint64_t more = 0;
+	uint64_t same = ~(uint64_t) 0;
+	size_t plane;
+	for (plane = PLANES; plane-- > 0;) {
+		if (limit & (1 << plane)) {
+			same &= mismatches[plane][word];
+		} else {
+			more |= same & mismatches[plane][word];
+			same &= ~mismatches[plane][word];
+		}
+	}
+	return more;
+}
+
+/* Compute the penalised probability of the primer aligned at the start position, adding the bases in the same order as they always have been, so the result is exactly the same. */
+static inline double alignment_probability(
+	const offset_seq *seq,
 	double penalty,
+	const panda_nt *primer,
+	size_t primerlen,
+	size_t start) {
+	double alignment = 0;
+	size_t it;
+	for (it = 0; it < primerlen; it++) {
+		if (!PANDA_NT_IS_N(primer[it])) {
+			alignment += ((seq->nt[start + it] & primer[it]) != 0) ? seq->probability[start + it] : seq->notprobability[start + it];
+		}
+	}
+	return exp(alignment / (start + primerlen + 1)) - (start + primerlen) * penalty;
+}
+
+static void offset_seq_prepare(
+	offset_seq *seq,
 	bool reverse,
-	const unsigned char *seq,
-	size_t seq_length,
+	const unsigned char *data,
+	size_t length,
 	size_t size,
-	base_score score,
+	base_score score) {
+	size_t index;
+	size_t it;
+	assert(length <= 2 * MAX_LEN);
+	memset(seq->nucleotides, 0, sizeof(seq->nucleotides));
+	seq->best_probability = -INFINITY;
+	seq->best_notprobability = -INFINITY;
+	seq->length = length;
+	for (index = 0; index < length; index++) {
+		score(&data[size * (reverse ? (length - index - 1) : index)], &seq->nt[index], &seq->probability[index], &seq->notprobability[index]);
+		for (it = 0; it < 4; it++) {
+			if (seq->nt[index] & (1 << it)) {
+				seq->nucleotides[it][index / 64] |= (uint64_t) 1 << (index % 64);
+			}
+		}
+		if (seq->probability[index] > seq->best_probability) {
+			seq->best_probability = seq->probability[index];
+		}
+		if (seq->notprobability[index] > seq->best_notprobability) {
+			seq->best_notprobability = seq->notprobability[index];
+		}
+	}
+}
+
+/*
+ * Find the primer in the sequence.
+ *
+ * The probability of the primer aligning at each start position is the sum of the log probabilities of the bases it covers being right, if they match, or wrong, if they don't. This is divided by one more than the position after the alignment, exponentiated, penalised for the distance from the start, and the best alignment better than the threshold is chosen. An alignment ending at the last base is never considered.
+ *
+ * Rather than scoring every alignment, the mismatches at 64 start positions at a time are counted using bit-sliced counters over the bases that can match each primer position. Since no match can score better than the best match and no mismatch better than the best mismatch, an alignment with too many mismatches cannot beat the best one found so far and is never scored.
+ */
+size_t offset_seq_find(
+	const offset_seq *seq,
+	double threshold,
+	double penalty,
 	const panda_nt *primer,
-	size_t primerlen) {
-	/* Circular buffer of probabilities of primer alignment indexed by the offset. */
-	double probabilities[primerlen];
+	size_t primerlen,
+	double *probability) {
+	uint64_t mismatches[PLANES][OFFSET_WORDS];
+	size_t known = 0;
 	double bestpr = exp(primerlen * threshold);
+	double log_bestpr = log(bestpr);
 	size_t bestindex = 0;
 	size_t index;
-	if (primerlen > seq_length) {
+	size_t it;
+	if (primerlen > seq->length || primerlen == 0) {
 		return 0;
 	}
+	if (*probability > bestpr) {
+		bestpr = *probability;
+		log_bestpr = log(bestpr);
+	}
+	for (it = 0; it < primerlen; it++) {
+		if (!PANDA_NT_IS_N(primer[it])) {
+			known++;
+		}
+	}
+
+	/* Count the mismatches of the alignments starting in each block of 64 positions. */
+	for (index = 0; index + primerlen < seq->length; index += 64) {
+		uint64_t saturated = 0;
+		size_t plane;
+		for (plane = 0; plane < PLANES; plane++) {
+			mismatches[plane][index / 64] = 0;
+		}
+		for (it = 0; it < primerlen; it++) {
+			uint64_t carry = 0;
+			size_t nt;
+			if (PANDA_NT_IS_N(primer[it])) {
+				continue;
+			}
+			for (nt = 0; nt < 4; nt++) {
+				if (primer[it] & (1 << nt)) {
+					carry |= window(seq->nucleotides[nt], index + it);
+				}
+			}
+			carry = ~carry;
+			for (plane = 0; plane < PLANES; plane++) {
+				uint64_t next = mismatches[plane][index / 64] & carry;
+				mismatches[plane][index / 64] ^= carry;
+				carry = next;
+			}
+			saturated |= carry;
+		}
+		for (plane = 0; plane < PLANES; plane++) {
+			mismatches[plane][index / 64] |= saturated;
+		}
+	}
+
+	if (penalty >= 0 && seq->best_notprobability <= seq->best_probability) {
+		/* Nothing before a complete alignment can beat a probability that isn't negative. */
+		double difference = seq->best_probability - seq->best_notprobability;
+		for (index = 0; index + primerlen < seq->length; index += 64) {
+			size_t last_start = seq->length - 1 - primerlen;
+			uint64_t candidates = last_start - index >= 63 ? ~(uint64_t) 0 : (((uint64_t) 1 << (last_start - index + 1)) - 1);
+			/* Rule out the whole block's alignments that have more mismatches than the most any of them could have and still win. */
+			double limit = log_bestpr - 1e-9 * (1 + fabs(log_bestpr));
+			double first = known * seq->best_probability - (index + primerlen + 1) * limit;
+			double last = known * seq->best_probability - ((last_start - index >= 63 ? index + 63 : last_start) + primerlen + 1) * limit;
+			double allowed = (first > last ? first : last) / difference;
+			if (difference > 0 && allowed < (1 << PLANES) - 1) {
+				candidates = (allowed < 0) ? 0 : (candidates & ~more_mismatches(mismatches, index / 64, (size_t) allowed));
+			}
+			while (candidates != 0) {
+				size_t start = index + __builtin_ctzll(candidates);
+				size_t count = 0;
+				size_t plane;
+				double last_pr;
+				candidates &= candidates - 1;
+				for (plane = 0; plane < PLANES; plane++) {
+					count |= ((mismatches[plane][start / 64] >> (start % 64)) & 1) << plane;
+				}
+				/* Skip alignments that cannot win, leaving a little room for rounding. */
+				if ((count * seq->best_notprobability + (known - count) * seq->best_probability) / (start + primerlen + 1) < log_bestpr - 1e-9 * (1 + fabs(log_bestpr))) {
+					continue;
+				}
+				last_pr = alignment_probability(seq, penalty, primer, primerlen, start);
+				if (last_pr > bestpr) {
+					bestpr = last_pr;
+					log_bestpr = log(bestpr);
+					bestindex = start + primerlen + 1;
+				}
+			}
+		}
+	} else {
+		for (index = 0; index < seq->length; index++) {
+			/* There is no complete alignment ending before this position. */
+			double last_pr = (index < primerlen) ? (0 - index * penalty) : alignment_probability(seq, penalty, primer, primerlen, index - primerlen);
+			/* If this complete alignment is better than we have seen previously, store it. */
+			if (last_pr > bestpr) {
+				bestpr = last_pr;
+				log_bestpr = log(bestpr);
+				bestindex = index + 1;
+			}
+		}
+	}
+	if (bestindex > 0) {
+		*probability = bestpr;
+	}
+	return bestindex;
+}
+
+double offset_seq_expected(
+	const offset_seq *seq,
+	double penalty,
+	const panda_nt *primer,
+	size_t primerlen,
+	size_t offset) {
+	double alignment = 0;
+	size_t known = 0;
+	size_t start;
+	size_t it;
+	/* The alignment ending at this offset would have been found at index offset - 1, which must be after a complete alignment and not the last base. */
+	if (primerlen == 0 || offset <= primerlen || offset > seq->length) {
+		return -INFINITY;
+	}
+	start = offset - 1 - primerlen;
+	for (it = 0; it < primerlen; it++) {
+		if (!PANDA_NT_IS_N(primer[it])) {
+			alignment += ((seq->nt[start + it] & primer[it]) != 0) ? seq->probability[start + it] : seq->notprobability[start + it];
+			known++;
+		}
+	}
+	if (known == 0) {
+		return -INFINITY;
+	}
+	return exp(alignment / known) - (offset - 1) * penalty;
+}
 
-	for (index = 0; index < primerlen; index++) {
-		probabilities[index] = -INFINITY;
+static size_t computeoffset(
+	double threshold,
+	double penalty,
+	bool reverse,
+	const unsigned char *data,
+	size_t length,
+	size_t size,
+	base_score score,
+	const panda_nt *primer,
+	size_t primerlen) {
+	offset_seq seq;
+	double probability = -INFINITY;
+	if (primerlen > length || primerlen == 0) {
+		return 0;
 	}
+	offset_seq_prepare(&seq, reverse, data, length, size, score);
+	return offset_seq_find(&seq, threshold, penalty, primer, primerlen, &probability);
+}
 
-	for (index = 0; index < seq_length; index++) {
-		ptrdiff_t x;
-		double last_pr = exp(probabilities[CIRC(index, primerlen)] / (index + 1)) - index * penalty;
-		/* The last bucket in the buffer holds the probability of a complete alignment. If it so better than we have seen previously, store it. */
-		if (last_pr > bestpr) {
-			bestpr = last_pr;
-			bestindex = index + 1;
+/*
+ * Check whether the primer ends at any of the expected offsets, in order, before searching the whole sequence.
+ *
+ * The probability used by the full search is normalised by the distance from the start of the sequence, so any alignment far enough down the sequence beats the threshold. Instead, an expected offset is accepted as soon as the primer bases there match with a mean probability, less the penalty, better than the threshold, without looking for a better one elsewhere.
+ */
+static size_t computeoffset_expected(
+	double threshold,
+	double penalty,
+	bool reverse,
+	const unsigned char *seq,
+	size_t seq_length,
+	size_t size,
+	base_score score,
+	const panda_nt *primer,
+	size_t primerlen,
+	const size_t *expected,
+	size_t expected_length) {
+	double threshold_pr = exp(threshold);
+	size_t known = 0;
+	size_t e;
+	size_t it;
+	if (primerlen > seq_length || primerlen == 0) {
+		return 0;
+	}
+	for (it = 0; it < primerlen; it++) {
+		if (!PANDA_NT_IS_N(primer[it])) {
+			known++;
+		}
+	}
+	for (e = 0; e < expected_length && known > 0; e++) {
+		/* The alignment ending at this offset would have been found at index offset - 1, which must be after a complete alignment and not the last base. */
+		size_t start;
+		double alignment = 0;
+		if (expected[e] <= primerlen || expected[e] > seq_length) {
+			continue;
 		}
-		probabilities[CIRC(index, primerlen)] = 0;
-		for (x = (ptrdiff_t) (primerlen > index ? index : primerlen - 1); x >= 0; x--) {
-			if (!PANDA_NT_IS_N(primer[x])) {
+		start = expected[e] - 1 - primerlen;
+		for (it = 0; it < primerlen; it++) {
+			if (!PANDA_NT_IS_N(primer[it])) {
 				panda_nt nt;
 				double p;
 				double notp;
-				score(&seq[size * (reverse ? (seq_length - index - 1) : index)], &nt, &p, &notp);
-				probabilities[CIRC(index - x, primerlen)] += ((nt & primer[x]) != 0) ? p : notp;
+				score(&seq[size * (reverse ? (seq_length - start - it - 1) : (start + it))], &nt, &p, &notp);
+				alignment += ((nt & primer[it]) != 0) ? p : notp;
 			}
 		}
+		if (exp(alignment / known) - (expected[e] - 1) * penalty > threshold_pr) {
+			return expected[e];
+		}
 	}
-	return bestindex;
+	return computeoffset(threshold, penalty, reverse, seq, seq_length, size, score, primer, primerlen);
 }
 
 void qual_base_score(
@@ -111,6 +363,19 @@ size_t panda_compute_offset_qual(
 	return computeoffset(threshold, penalty, reverse, (const unsigned char *) haystack, haystack_length, sizeof(panda_qual), qual_base_score, needle, needle_length);
 }
 
+size_t panda_compute_offset_qual_expected(
+	double threshold,
+	double penalty,
+	bool reverse,
+	const panda_qual *haystack,
+	size_t haystack_length,
+	const panda_nt *needle,
+	size_t needle_length,
+	const size_t *expected,
+	size_t expected_length) {
+	return computeoffset_expected(threshold, penalty, reverse, (const unsigned char *) haystack, haystack_length, sizeof(panda_qual), qual_base_score, needle, needle_length, expected, expected_length);
+}
+
 void result_base_score(
 	const void *data,
 	panda_nt *base,
@@ -131,3 +396,32 @@ size_t panda_compute_offset_result(
 	size_t needle_length) {
 	return computeoffset(threshold, penalty, reverse, (const unsigned char *) haystack, haystack_length, sizeof(panda_result), result_base_score, needle, needle_length);
 }
+
+size_t panda_compute_offset_result_expected(
+	double threshold,
+	double penalty,
+	bool reverse,
+	const panda_result *haystack,
+	size_t haystack_length,
+	const panda_nt *needle,
+	size_t needle_length,
+	const size_t *expected,
+	size_t expected_length) {
+	return computeoffset_expected(threshold, penalty, reverse, (const unsigned char *) haystack, haystack_length, sizeof(panda_result), result_base_score, needle, needle_length, expected, expected_length);
+}
+
+void offset_seq_prepare_qual(
+	offset_seq *seq,
+	bool reverse,
+	const panda_qual *haystack,
+	size_t haystack_length) {
+	offset_seq_prepare(seq, reverse, (const unsigned char *) haystack, haystack_length, sizeof(panda_qual), qual_base_score);
+}
+
+void offset_seq_prepare_result(
+	offset_seq *seq,
+	bool reverse,
+	const panda_result *haystack,
+	size_t haystack_length) {
+	offset_seq_prepare(seq, reverse, (const unsigned char *) haystack, haystack_length, sizeof(panda_result), result_base_score);
+}
@@ -0,0 +1,81 @@
+/* PANDAseq -- Assemble paired FASTQ Illumina reads and strip the region between amplification primers.
+     Copyright (C) 2011-2013  Andre Masella
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+#ifndef OFFSET_H
+#        define OFFSET_H
+#        include <stdint.h>
+#        include "config.h"
+#        include "pandaseq.h"
+
+/* Enough words to hold an assembled sequence plus one spare word so that a 64-bit window starting anywhere in it can be read without checking bounds. */
+#        define OFFSET_WORDS (2 * MAX_LEN / 64 + 2)
+
+/*
+ * A sequence prepared for primer searches, in the order it is scanned: the nucleotide of every base, the log probability of it being right and wrong, and bit planes where bit i of nucleotides[b] is set if base i could be nucleotide b (A, C, G, T). Any number of primers can then be found without decoding the sequence again.
+ */
+typedef struct {
+	panda_nt nt[2 * MAX_LEN];
+	double probability[2 * MAX_LEN];
+	double notprobability[2 * MAX_LEN];
+	uint64_t nucleotides[4][OFFSET_WORDS];
+	/* The best scores any base contributes when it matches and when it doesn't. */
+	double best_probability;
+	double best_notprobability;
+	size_t length;
+} offset_seq;
+
+/*
+ * Prepare a read for primer searches. If reverse is set, it is scanned from the end.
+ */
+void offset_seq_prepare_qual(
+	offset_seq *seq,
+	bool reverse,
+	const panda_qual *haystack,
+	size_t haystack_length);
+
+/*
+ * Prepare an assembled sequence for primer searches. If reverse is set, it is scanned from the end.
+ */
+void offset_seq_prepare_result(
+	offset_seq *seq,
+	bool reverse,
+	const panda_result *haystack,
+	size_t haystack_length);
+
+/*
+ * Find a primer in a prepared sequence, exactly as panda_compute_offset_qual does, except that the primer must also do better than the penalised probability supplied in probability. If found, the penalised probability of the primer at that offset is stored there.
+ *
+ * When searching for the best of several primers, passing the best probability so far skips any alignment of the later primers that cannot beat it.
+ */
+size_t offset_seq_find(
+	const offset_seq *seq,
+	double threshold,
+	double penalty,
+	const panda_nt *primer,
+	size_t primerlen,
+	double *probability);
+
+/*
+ * Score a primer ending at an offset, as returned by offset_seq_find, the way panda_compute_offset_qual_expected does: the mean probability of the primer bases matching, less the penalty for each base from the start. Returns negative infinity if the primer cannot end there.
+ */
+double offset_seq_expected(
+	const offset_seq *seq,
+	double penalty,
+	const panda_nt *primer,
+	size_t primerlen,
+	size_t offset);
+#endif
@@ -77,6 +77,8 @@ const char *panda_code_str(
 		return "INFO\tMISM";
 	case PANDA_CODE_PHRED_OFFSET:
 		return "INFO\tPHRED OFFSET";
+	case PANDA_CODE_NO_SEEDS:
+		return "ERR\tNOSEED";
 	default:
 		return "ERR\tUNKNOWN ERROR";
 	}
@@ -95,7 +97,7 @@ bool panda_output_fasta(
 
 	panda_writer_append_c(writer, '\n');
 	for (it = 0; it < sequence->sequence_length; it++) {
-		panda_writer_append_c(writer, panda_nt_to_ascii(sequence->sequence[it].nt));
+		panda_writer_append_c(writer, panda_nt_to_ascii(sequence->compact != NULL ? sequence->compact[it].nt : sequence->sequence[it].nt));
 	}
 	panda_writer_append_c(writer, '\n');
 	panda_writer_commit(writer);
@@ -113,12 +115,22 @@ bool panda_output_fastq(
 	panda_writer_append_id(writer, &sequence->name);
 	panda_writer_append(writer, ";%f", exp(sequence->quality));
 	panda_writer_append_c(writer, '\n');
-	for (it = 0; it < sequence->sequence_length; it++) {
-		panda_writer_append_c(writer, panda_nt_to_ascii(sequence->sequence[it].nt));
-	}
-	panda_writer_append(writer, "\n+\n");
-	for (it = 0; it < sequence->sequence_length; it++) {
-		panda_writer_append_c(writer, 33 + panda_result_phred(&sequence->sequence[it]));
+	if (sequence->compact != NULL) {
+		for (it = 0; it < sequence->sequence_length; it++) {
+			panda_writer_append_c(writer, panda_nt_to_ascii(sequence->compact[it].nt));
+		}
+		panda_writer_append(writer, "\n+\n");
+		for (it = 0; it < sequence->sequence_length; it++) {
+			panda_writer_append_c(writer, 33 + sequence->compact[it].phred);
+		}
+	} else {
+		for (it = 0; it < sequence->sequence_length; it++) {
+			panda_writer_append_c(writer, panda_nt_to_ascii(sequence->sequence[it].nt));
+		}
+		panda_writer_append(writer, "\n+\n");
+		for (it = 0; it < sequence->sequence_length; it++) {
+			panda_writer_append_c(writer, 33 + panda_result_phred(&sequence->sequence[it]));
+		}
 	}
 	panda_writer_append_c(writer, '\n');
 	panda_writer_commit(writer);
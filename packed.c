@@ -0,0 +1,118 @@
+/* PANDAseq -- Assemble paired FASTQ Illumina reads and strip the region between amplification primers.
+     Copyright (C) 2011-2013  Andre Masella
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+#include "config.h"
+#include <assert.h>
+#include <string.h>
+#include "pandaseq.h"
+#include "packed.h"
+
+void packed_seq_build(
+	packed_seq *packed,
+	const panda_qual *seq,
+	size_t length,
+	bool reverse) {
+	size_t i;
+	assert(length <= MAX_LEN);
+	memset(packed->bases, 0, sizeof(packed->bases));
+	memset(packed->unknown, 0, sizeof(packed->unknown));
+	packed->length = length;
+	for (i = 0; i < length; i++) {
+		panda_nt nt = seq[reverse ? (length - i - 1) : i].nt;
+		size_t word = i / 64;
+		uint64_t bit = (uint64_t) 1 << (i % 64);
+		if (nt & PANDA_NT_A)
+			packed->bases[0][word] |= bit;
+		if (nt & PANDA_NT_C)
+			packed->bases[1][word] |= bit;
+		if (nt & PANDA_NT_G)
+			packed->bases[2][word] |= bit;
+		if (nt & PANDA_NT_T)
+			packed->bases[3][word] |= bit;
+		if (PANDA_NT_IS_N(nt))
+			packed->unknown[word] |= bit;
+	}
+}
+
+/* Get the 64 bits starting at an arbitrary bit position. */
+static inline uint64_t window(
+	const uint64_t *words,
+	size_t start) {
+	size_t word = start / 64;
+	size_t shift = start % 64;
+	return shift == 0 ? words[word] : (words[word] >> shift) | (words[word + 1] << (64 - shift));
+}
+
+void packed_seq_count(
+	const packed_seq *forward,
+	const packed_seq *reverse,
+	size_t overlap,
+	size_t *matches,
+	size_t *mismatches,
+	size_t *unknowns) {
+	/* Only the part of the overlap where both reads have bases counts. In the reversed reverse read, this is [start, end). */
+	size_t start = overlap > forward->length ? overlap - forward->length : 0;
+	size_t end = overlap < reverse->length ? overlap : reverse->length;
+	size_t forward_start = forward->length + start - overlap;
+	size_t i;
+
+	*matches = 0;
+	*unknowns = 0;
+	*mismatches = 0;
+	for (i = start; i < end; i += 64) {
+		uint64_t mask = end - i >= 64 ? ~(uint64_t) 0 : (((uint64_t) 1 << (end - i)) - 1);
+		size_t f = forward_start + i - start;
+		uint64_t match = (window(forward->bases[0], f) & window(reverse->bases[0], i)) | (window(forward->bases[1], f) & window(reverse->bases[1], i)) | (window(forward->bases[2], f) & window(reverse->bases[2], i)) | (window(forward->bases[3], f) & window(reverse->bases[3], i));
+		uint64_t unknown = (window(forward->unknown, f) | window(reverse->unknown, i)) & mask;
+		*unknowns += __builtin_popcountll(unknown);
+		*matches += __builtin_popcountll(match & mask & ~unknown);
+	}
+	if (end > start) {
+		*mismatches = end - start - *matches - *unknowns;
+	}
+}
+
+void count_overlap(
+	const panda_qual *forward,
+	size_t forward_length,
+	const panda_qual *reverse,
+	size_t reverse_length,
+	size_t overlap,
+	size_t *matches,
+	size_t *mismatches,
+	size_t *unknowns) {
+	size_t i;
+
+	*matches = 0;
+	*mismatches = 0;
+	*unknowns = 0;
+	for (i = 0; i < overlap; i++) {
+		int findex = forward_length + i - overlap;
+		int rindex = reverse_length - i - 1;
+		if (findex < 0 || rindex < 0 || (size_t) findex >= forward_length || (size_t) rindex >= reverse_length)
+			continue;
+		panda_nt f = forward[findex].nt;
+		panda_nt r = reverse[rindex].nt;
+		if (PANDA_NT_IS_N(f) || PANDA_NT_IS_N(r)) {
+			(*unknowns)++;
+		} else if ((f & r) != 0) {
+			(*matches)++;
+		} else {
+			(*mismatches)++;
+		}
+	}
+}
@@ -0,0 +1,68 @@
+/* PANDAseq -- Assemble paired FASTQ Illumina reads and strip the region between amplification primers.
+     Copyright (C) 2011-2013  Andre Masella
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+#ifndef PACKED_H
+#        define PACKED_H
+#        include <stdint.h>
+#        include "config.h"
+#        include "pandaseq.h"
+
+/* Enough words to hold a read plus one spare word so that a 64-bit window starting anywhere in the read can be read without checking bounds. */
+#        define PACKED_WORDS (MAX_LEN / 64 + 2)
+
+/*
+ * A read stored as bit planes: bit i of bases[b] is set if base i could be nucleotide b (A, C, G, T) and bit i of unknown is set if base i is an N. Comparing two reads 64 bases at a time is then just a few logical operations and a population count.
+ */
+typedef struct {
+	uint64_t bases[4][PACKED_WORDS];
+	uint64_t unknown[PACKED_WORDS];
+	size_t length;
+} packed_seq;
+
+/*
+ * Fill the bit planes from a read. If reverse is set, the read is stored back-to-front, which is the orientation in which a reverse read is compared to a forward one.
+ */
+void packed_seq_build(
+	packed_seq *packed,
+	const panda_qual *seq,
+	size_t length,
+	bool reverse);
+
+/*
+ * Count the matching, mismatching, and unknown bases when the forward read is overlapped with the reverse read by the supplied amount. The reverse read must have been built reversed.
+ */
+void packed_seq_count(
+	const packed_seq *forward,
+	const packed_seq *reverse,
+	size_t overlap,
+	size_t *matches,
+	size_t *mismatches,
+	size_t *unknowns);
+
+/*
+ * Count the same quantities as packed_seq_count, one base at a time, directly from the reads.
+ */
+void count_overlap(
+	const panda_qual *forward,
+	size_t forward_length,
+	const panda_qual *reverse,
+	size_t reverse_length,
+	size_t overlap,
+	size_t *matches,
+	size_t *mismatches,
+	size_t *unknowns);
+#endif
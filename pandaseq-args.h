@@ -227,6 +227,18 @@ PANDA_EXTERN const panda_tweak_assembler panda_stdargs_module;
  * The penalise primers if they are further from the start of the sequence (-D).
  */
 PANDA_EXTERN const panda_tweak_assembler panda_stdargs_primer_penalty;
+/**
+ * The number of common primer offsets to check first switch (-E).
+ */
+PANDA_EXTERN const panda_tweak_assembler panda_stdargs_primer_expected;
+/**
+ * The overlap histogram warm-up switch (-H).
+ */
+PANDA_EXTERN const panda_tweak_assembler panda_stdargs_overlap_warmup;
+/**
+ * The k-mer length switch (-K).
+ */
+PANDA_EXTERN const panda_tweak_assembler panda_stdargs_kmer_length;
 /**
  * The minimum length filter switch (-l).
  */
@@ -247,6 +259,10 @@ PANDA_EXTERN const panda_tweak_assembler panda_stdargs_min_overlap;
  * The maximum overlap switch (-O).
  */
 PANDA_EXTERN const panda_tweak_assembler panda_stdargs_max_overlap;
+/**
+ * The seeding policy switch (-S).
+ */
+PANDA_EXTERN const panda_tweak_assembler panda_stdargs_seed_policy;
 /**
  * The forward primer filter switch (-p).
  */
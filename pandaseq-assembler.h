@@ -50,12 +50,34 @@ PandaAssembler panda_assembler_new(
  */
 #        define PANDA_DEFAULT_NUM_KMERS 2
 
+/**
+ * The default length of the k-mers used to find candidate overlaps.
+ */
+#        define PANDA_DEFAULT_KMER_LENGTH 8
+/**
+ * The shortest k-mer length an assembler can use.
+ */
+#        define PANDA_MIN_KMER_LENGTH 6
+/**
+ * The longest k-mer length an assembler can use.
+ */
+#        define PANDA_MAX_KMER_LENGTH 16
+
+/**
+ * The policy that only includes a particular way of finding candidate overlaps.
+ */
+#        define PANDA_SEED_POLICY(seed) ((PandaSeedPolicy) (1 << (seed)))
+/**
+ * The default seeding policy: shared k-mers, or every overlap if there are none.
+ */
+#        define PANDA_SEED_POLICY_DEFAULT (PANDA_SEED_POLICY(PANDA_SEED_KMER) | PANDA_SEED_POLICY(PANDA_SEED_ALL))
+
 /**
  * Create a new assembler from a sequence source with a custom k-mer table size.
  *
  * @next: (closure next_data) (scope notified) (allow-none): the function to call to get the next sequence. The assembler does not manage the memory of the returned arrays, but assume it may use them until the next call of next(next_data) or next_destroy(next_data). When the assembler is destroyed, it will call next_destroy(next_data). If null, only panda_assembler_assemble may be used and not panda_assembler_next.
  * @logger: the proxy to call to report information to the user
- * @num_kmers: the number of sequence locations for a particular k-mer. The default is PANDA_DEFAULT_NUM_KMERS. This should be small (no more than 10), or the k-mer table will be extremely large.
+ * @num_kmers: the number of sequence locations for a particular k-mer. The default is PANDA_DEFAULT_NUM_KMERS. The k-mer table is sized to the read, so this only needs to be large for highly repetitive sequences.
  * @see panda_assembler_new
  */
 PandaAssembler panda_assembler_new_kmer(
@@ -139,6 +161,22 @@ const panda_result_seq *panda_assembler_assemble(
 	const panda_qual *reverse,
 	size_t reverse_length);
 
+/**
+ * Assemble many read pairs not drawn from the sequence stream.
+ *
+ * Each read pair is assembled exactly as panda_assembler_assemble would, but work that does not depend on the read pair is done once for the whole batch.
+ * @pairs: (array length=pairs_length): the read pairs to assemble
+ * @results: (array length=pairs_length) (out caller-allocates): the results for each read pair. Their contents on entry are ignored, so the array need not be initialised. The sequence and compact members point to space owned by the assembler, which is only valid until panda_assembler_assemble_batch is called again or the assembler is destroyed. Either may be null, as described in panda_assembler_set_compact_results. Results for read pairs that are rejected are not meaningful.
+ * @rejects: (array length=pairs_length) (allow-none): the reason each read pair was rejected, or PANDA_REJECT_NONE if it was assembled
+ * Returns: the number of read pairs assembled
+ */
+size_t panda_assembler_assemble_batch(
+	PandaAssembler assembler,
+	const panda_read_pair *pairs,
+	size_t pairs_length,
+	panda_result_seq *results,
+	PandaReject *rejects);
+
 /**
  * Clone the configuration of one assembler to another.
  *
@@ -208,6 +246,17 @@ void panda_assembler_set_algorithm(
 long panda_assembler_get_bad_read_count(
 	PandaAssembler assembler);
 
+/**
+ * Whether to store the quality of each base of assembled sequences as a PHRED score.
+ *
+ * If set, the compact member of each result holds the nucleotides and PHRED scores, which is all the FASTA and FASTQ output needs. The log probabilities in the sequence member are only filled in if a module added to the assembler uses them (see panda_module_set_uses_sequence) or primers are stripped after assembly. Otherwise, the sequence of the results from panda_assembler_assemble and panda_assembler_next is null. The default is false.
+ */
+bool panda_assembler_get_compact_results(
+	PandaAssembler assembler);
+void panda_assembler_set_compact_results(
+	PandaAssembler assembler,
+	bool compact);
+
 /**
  * The number of sequences processed so far.
  */
@@ -243,6 +292,25 @@ panda_nt *panda_assembler_get_forward_primer(
 	PandaAssembler assembler,
 	size_t *length);
 
+/**
+ * Add a named primer to the set of forward primers to be stripped.
+ *
+ * Each sequence is prepared once and searched for every primer in the set, the one that matches best is stripped, and its name is stored in the result. This is mutually exclusive with forward_primer and forward_trim; setting either of them clears the set.
+ * @name: the name of the primer, which is copied
+ * @sequence: (array length=length): the primer sequence, which is copied
+ */
+void panda_assembler_add_forward_primer(
+	PandaAssembler assembler,
+	const char *name,
+	const panda_nt *sequence,
+	size_t length);
+/**
+ * The set of forward primers to be stripped.
+ * Returns: (array length=length) (transfer none) (allow-none): If there is no set of primers, this will return null and set length to 0.
+ */
+const panda_primer *panda_assembler_get_forward_primers(
+	PandaAssembler assembler,
+	size_t *length);
 /**
  * The forward primer sequence to be stripped
  * @sequence: (array length_length) (allow-none): The primer sequene.
@@ -321,6 +389,52 @@ long panda_assembler_get_no_reverse_primer_count(
 size_t panda_assembler_get_num_kmer(
 	PandaAssembler assembler);
 
+/**
+ * The length of the k-mers shared between the reads used to find candidate overlaps.
+ *
+ * Longer k-mers suggest fewer spurious overlaps, but noisy reads may not share any, in which case every overlap is checked. It must be between PANDA_MIN_KMER_LENGTH and PANDA_MAX_KMER_LENGTH; other values are ignored.
+ */
+size_t panda_assembler_get_kmer_length(
+	PandaAssembler assembler);
+void panda_assembler_set_kmer_length(
+	PandaAssembler assembler,
+	size_t length);
+
+/**
+ * The ways of finding candidate overlaps that will be tried.
+ *
+ * They are tried in the order of #PandaSeed until one finds any candidates. If the policy does not include PANDA_SEED_ALL, read pairs that none of the others find candidates for are not assembled.
+ */
+PandaSeedPolicy panda_assembler_get_seed_policy(
+	PandaAssembler assembler);
+void panda_assembler_set_seed_policy(
+	PandaAssembler assembler,
+	PandaSeedPolicy policy);
+
+/**
+ * The number of sequences whose candidate overlaps were found by a particular seeding method.
+ */
+long panda_assembler_get_seed_count(
+	PandaAssembler assembler,
+	PandaSeed seed);
+
+/**
+ * The number of sequences that must be assembled before their overlaps are used to guide the search for the overlap of new ones.
+ *
+ * Once warmed up, the candidate overlaps closest to the most common overlap so far are scored first, and the search widens outward. As soon as the best candidate found has at least the threshold fraction of its known bases matching, the more distant candidates are not examined. This is much faster for amplicons with a narrow distribution of overlaps, but a better overlap far from the usual one may be missed. If zero, which is the default, every candidate is examined.
+ */
+size_t panda_assembler_get_overlap_warmup(
+	PandaAssembler assembler);
+void panda_assembler_set_overlap_warmup(
+	PandaAssembler assembler,
+	size_t warmup);
+
+/**
+ * The number of sequences whose overlap was chosen without examining the candidates far from the most common overlap.
+ */
+long panda_assembler_get_prior_count(
+	PandaAssembler assembler);
+
 /**
  * The number of sequences accepted.
  */
@@ -354,6 +468,25 @@ void panda_assembler_set_primers_after(
 panda_nt *panda_assembler_get_reverse_primer(
 	PandaAssembler assembler,
 	size_t *length);
+/**
+ * Add a named primer to the set of reverse primers to be stripped.
+ *
+ * Each sequence is prepared once and searched for every primer in the set, the one that matches best is stripped, and its name is stored in the result. This is mutually exclusive with reverse_primer and reverse_trim; setting either of them clears the set.
+ * @name: the name of the primer, which is copied
+ * @sequence: (array length=length): the primer sequence, which is copied
+ */
+void panda_assembler_add_reverse_primer(
+	PandaAssembler assembler,
+	const char *name,
+	const panda_nt *sequence,
+	size_t length);
+/**
+ * The set of reverse primers to be stripped.
+ * Returns: (array length=length) (transfer none) (allow-none): If there is no set of primers, this will return null and set length to 0.
+ */
+const panda_primer *panda_assembler_get_reverse_primers(
+	PandaAssembler assembler,
+	size_t *length);
 /**
  * The reverse primer sequence to be stripped
  * @sequence: (array length_length) (allow-none): The primer sequene.
@@ -404,5 +537,34 @@ void panda_assembler_set_primer_penalty(
 	PandaAssembler assembler,
 	double threshold);
 
+/**
+ * The number of the most common primer offsets so far to check before searching the whole sequence for a primer.
+ *
+ * The first of these offsets where the primer bases match with a mean probability, less the primer penalty, better than the threshold is used, even if the primer would have matched better elsewhere. This is much faster for amplicons, where the primers are nearly always in the same place. For a set of primers, the offsets are shared by the whole set and the best primer at the first good enough offset is used. If zero, which is the default, the whole sequence is always searched. At most 16 offsets can be checked.
+ */
+size_t panda_assembler_get_primer_expected(
+	PandaAssembler assembler);
+void panda_assembler_set_primer_expected(
+	PandaAssembler assembler,
+	size_t expected);
+
+/**
+ * Report the number of sequences where the primer was found at the offset specified.
+ * @reverse: whether to report the reverse primer, rather than the forward primer
+ * @offset: the offset, as returned by panda_compute_offset_qual
+ */
+long panda_assembler_get_primer_offset_count(
+	PandaAssembler assembler,
+	bool reverse,
+	size_t offset);
+
+/**
+ * The largest offset at which a primer has been found so far.
+ * @reverse: whether to report the reverse primer, rather than the forward primer
+ */
+size_t panda_assembler_get_longest_primer_offset(
+	PandaAssembler assembler,
+	bool reverse);
+
 EXTERN_C_END
 #endif
@@ -35,6 +35,7 @@
 #                define PANDA_EXTERN extern
 #        endif
 #        include <stdarg.h>
+#        include <stddef.h>
 #        include <stdio.h>
 #        include <stdbool.h>
 EXTERN_C_BEGIN
@@ -75,6 +76,11 @@ typedef struct panda_args_fastq *PandaArgsFastq;
  */
 typedef struct panda_args_hang *PandaArgsHang;
 
+/**
+ * A router that writes each assembled sequence to the output for its sample, based on the tag in its identifier.
+ */
+typedef struct panda_demux *PandaDemux;
+
 /**
  * Iterate over a sequence presenting all k-mers without Ns or other denegerate bases.
  *
@@ -152,6 +158,7 @@ typedef enum {
 	PANDA_CODE_REVERSE_KMER,
 	PANDA_CODE_SEQUENCE_TOO_LONG,
 	PANDA_CODE_PHRED_OFFSET,
+	PANDA_CODE_NO_SEEDS,
 } PandaCode;
 
 /**
@@ -177,6 +184,67 @@ typedef enum {
 	PANDA_TAG_OPTIONAL,
 } PandaTagging;
 
+/**
+ * The ways the assembler can find candidate overlaps. They are tried in this order, until one finds any candidates.
+ */
+typedef enum {
+	/**
+	 * k-mers of the assembler's k-mer length shared between the reads.
+	 */
+	PANDA_SEED_KMER,
+	/**
+	 * Spaced seeds: eight bases out of eleven shared between the reads, so a single error only spoils the seeds using that base.
+	 */
+	PANDA_SEED_SPACED,
+	/**
+	 * k-mers two bases shorter than the assembler's k-mer length, but no shorter than PANDA_MIN_KMER_LENGTH.
+	 */
+	PANDA_SEED_SHORT,
+	/**
+	 * Every possible overlap.
+	 */
+	PANDA_SEED_ALL,
+} PandaSeed;
+
+/**
+ * The set of ways to find candidate overlaps an assembler will try.
+ */
+typedef unsigned int PandaSeedPolicy;
+
+/**
+ * Why a read pair was not assembled.
+ */
+typedef enum {
+	/**
+	 * The read pair was assembled and accepted.
+	 */
+	PANDA_REJECT_NONE,
+	/**
+	 * One of the reads is too short.
+	 */
+	PANDA_REJECT_BAD_READ,
+	/**
+	 * The forward primer could not be found.
+	 */
+	PANDA_REJECT_NO_FORWARD_PRIMER,
+	/**
+	 * The reverse primer could not be found.
+	 */
+	PANDA_REJECT_NO_REVERSE_PRIMER,
+	/**
+	 * No overlap could be found between the reads.
+	 */
+	PANDA_REJECT_NO_ALIGNMENT,
+	/**
+	 * The assembled sequence is below the quality threshold.
+	 */
+	PANDA_REJECT_LOW_QUALITY,
+	/**
+	 * A module rejected the read pair or the assembled sequence.
+	 */
+	PANDA_REJECT_MODULE,
+} PandaReject;
+
 /**
  * A single nucleotide
  */
@@ -229,6 +297,20 @@ typedef struct {
 	double p;
 } panda_result;
 
+/**
+ * A base in an assembled sequence with the quality as a PHRED score, rather than a log probability, so it takes an eighth of the space of panda_result.
+ */
+typedef struct {
+	/**
+	 * The nucleotide
+	 */
+	panda_nt nt;
+	/**
+	 * The quality score as a PHRED score, as panda_result_phred would give
+	 */
+	char phred;
+} panda_result_compact;
+
 /**
  * Illumina sequence information from the FASTQ header
  */
@@ -327,8 +409,50 @@ typedef struct {
 	 * The probability of the overlap region being the correct one by the original estimation.
 	 */
 	double estimated_overlap_probability;
+	/**
+	 * The reconstructed sequence with PHRED quality scores, if the assembler produces compact results. It has the same length as sequence.
+	 */
+	panda_result_compact *compact;
+	/**
+	 * The names of the primers stripped, if the assembler has sets of primers, or null.
+	 */
+	const char *forward_primer_name;
+	const char *reverse_primer_name;
+	/**
+	 * The number of bases sequence and compact have been moved forward to skip the forward primer when primers are stripped after assembly. The sequence is assembled into the space starting at sequence - sequence_offset.
+	 */
+	size_t sequence_offset;
 } panda_result_seq;
 
+/**
+ * A read pair to be assembled.
+ */
+typedef struct {
+	/**
+	 * The sequence identification information
+	 */
+	const panda_seq_identifier *name;
+	/**
+	 * The forward read
+	 */
+	panda_qual const *forward;
+	size_t forward_length;
+	/**
+	 * The reverse read
+	 */
+	panda_qual const *reverse;
+	size_t reverse_length;
+} panda_read_pair;
+
+/**
+ * A named primer, one of a set from which the best match is stripped.
+ */
+typedef struct {
+	char *name;
+	panda_nt *sequence;
+	size_t sequence_length;
+} panda_primer;
+
 /* === Function Pointers === */
 
 /**
@@ -396,6 +520,69 @@ typedef double (
 	size_t reverse_length,
 	size_t overlap);
 
+/**
+ * Compute the probability of many offsets and pick the best one.
+ *
+ * This is an optional alternative to #PandaComputeOverlap that allows an algorithm to share work, such as decoding the quality scores of the reads, between all the overlaps being considered.
+ *
+ * The best overlap is the one with the highest probability. If several overlaps have the same probability, the shortest one is chosen.
+ *
+ * @private_data: (closure): the private data for the algorithm
+ * @forward: (array length=forward_length): the forward read
+ * @reverse: (array length=reverse_length): the reverse read
+ * @overlaps: (array length=overlaps_length): the overlap lengths to check, in no particular order. The assembler places the overlaps best supported by shared k-mers first.
+ * @best_probability: (inout): the log probability an overlap must exceed to be chosen. This is updated with the log probability of the chosen overlap.
+ * @probabilities: (array length=overlaps_length) (allow-none): if not null, the log probability of every overlap must be stored here
+ * Return: the best overlap length, or -1 if none were better than the initial value of best_probability.
+ */
+typedef ptrdiff_t (
+	*PandaComputeOverlapBatch) (
+	void *private_data,
+	const panda_qual *forward,
+	size_t forward_length,
+	const panda_qual *reverse,
+	size_t reverse_length,
+	const size_t *overlaps,
+	size_t overlaps_length,
+	double *best_probability,
+	double *probabilities);
+
+/**
+ * Compute the probability of an offset being a good one from the number of matching, mismatching, and unknown bases in the overlapping region.
+ *
+ * Algorithms whose overlap probability depends only on these counts can provide this in addition to #PandaComputeOverlap and the assembler will count the bases many at a time rather than calling the algorithm for every base.
+ *
+ * @private_data: (closure): the private data for the algorithm
+ * @forward_length: the length of the forward read
+ * @reverse_length: the length of the reverse read
+ * @overlap: the overlap length to check
+ * @matches: the number of bases in the overlap where the reads agree
+ * @mismatches: the number of bases in the overlap where the reads disagree
+ * @unknowns: the number of bases in the overlap where either read is N
+ * Return: the log probability the overlap is correct.
+ */
+typedef double (
+	*PandaComputeOverlapCounts) (
+	void *private_data,
+	size_t forward_length,
+	size_t reverse_length,
+	size_t overlap,
+	size_t matches,
+	size_t mismatches,
+	size_t unknowns);
+
+/**
+ * Get the table of scores an algorithm computes its overlap probability from.
+ *
+ * Some algorithms built into the library score an overlap as a sum of scores looked up by the quality of each pair of bases. The assembler can then score overlaps from the reads it has already prepared using that table, rather than calling #PandaComputeOverlapBatch. The table is internal to the library, so other algorithms must not provide this.
+ *
+ * @private_data: (closure): the private data for the algorithm
+ * Return: (allow-none): the table, or null if the algorithm does not use one.
+ */
+typedef const void *(
+	*PandaGetOverlapTable) (
+	void *private_data);
+
 /**
  * Free user data
  *
@@ -508,6 +695,7 @@ typedef bool (
 
 /**
  * Check a sequence before reconstruction for validity.
+ * @id: The identifier of the sequence being assembled. Although it is constant, a check may correct the tag in place, such as to fix an index tag with an error; it must not change anything else, including the length of the tag, and the change is seen by the output and any later modules.
  * @forward: (array length=forward_length): The forward read.
  * @reverse: (array length=reverse_length): The reverse read.
  */
@@ -602,6 +790,22 @@ struct panda_algorithm_class {
 	PandaComputeOverlap overlap_probability;
 	PandaComputeMatch match_probability;
 	const double prob_unpaired;
+	/**
+	 * (allow-none): A faster way to compute the overlap probability from base counts.
+	 */
+	PandaComputeOverlapCounts overlap_counts;
+	/**
+	 * (allow-none): A faster way to compute the probability of all the overlaps of a pair of reads.
+	 */
+	PandaComputeOverlapBatch overlap_probability_batch;
+	/**
+	 * If set, match_probability depends only on whether the bases match and on their PHRED scores, clamped to the valid range, and never on the algorithm's data. The assembler can then compute it once for every combination and look it up while building the sequence.
+	 */
+	bool match_probability_fixed;
+	/**
+	 * (allow-none): The table the overlap probability is computed from. If it gives a table, the assembler scores overlaps with it instead of calling the other overlap methods, so they must agree with it. Only for algorithms built into the library.
+	 */
+	PandaGetOverlapTable overlap_table;
 };
 
 /**
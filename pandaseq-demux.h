@@ -0,0 +1,89 @@
+/* PANDAseq -- Assemble paired FASTQ Illumina reads and strip the region between amplification primers.
+     Copyright (C) 2011-2013  Andre Masella
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef _PANDASEQ_DEMUX_H
+#        define _PANDASEQ_DEMUX_H
+#        ifdef __cplusplus
+#                define EXTERN_C_BEGIN  extern "C" {
+#                define EXTERN_C_END    }
+#        else
+#                define EXTERN_C_BEGIN
+#                define EXTERN_C_END
+#        endif
+#        include <stdbool.h>
+EXTERN_C_BEGIN
+/* === Constructor === */
+/**
+ * Create a new demultiplexer with no samples.
+ * @output: the function used to write every sequence, such as panda_output_fasta. It will be given the writer for the sequence's sample.
+ * @unknown: the writer for sequences whose tag is missing or does not belong to any sample.
+ * @logger: (allow-none): where to write the number of sequences each sample received when the demultiplexer is released.
+ */
+PandaDemux panda_demux_new(
+	PandaOutputSeq output,
+	PandaWriter unknown,
+	PandaLogProxy logger);
+
+/* === Methods === */
+
+/**
+ * Send all sequences with a particular tag to a writer.
+ *
+ * Several tags may share a writer. Samples must be added before any sequences are written.
+ * Returns: false if the tag is empty, too long, or already belongs to a sample.
+ */
+bool panda_demux_add(
+	PandaDemux demux,
+	const char *tag,
+	PandaWriter writer);
+
+/**
+ * The number of sequences written for a sample.
+ * @tag: (allow-none): the sample's tag or null for sequences not belonging to any sample.
+ */
+long panda_demux_get_count(
+	PandaDemux demux,
+	const char *tag);
+
+/**
+ * Write an assembly to the writer for its sample. This is suitable for use as a #PandaOutputSeq.
+ *
+ * This is thread-safe if the output function is.
+ */
+bool panda_output_demux(
+	const panda_result_seq *sequence,
+	PandaDemux demux);
+
+/**
+ * Increase the reference count on a demultiplexer.
+ *
+ * This is thread-safe.
+ */
+PandaDemux panda_demux_ref(
+	PandaDemux demux);
+
+/**
+ * Decrease the reference count on a demultiplexer.
+ *
+ * This is thread-safe.
+ * @demux: (transfer full): the demultiplexer to be released.
+ */
+void panda_demux_unref(
+	PandaDemux demux);
+EXTERN_C_END
+#endif
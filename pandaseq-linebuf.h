@@ -49,5 +49,15 @@ void panda_linebuf_free(
  */
 const char *panda_linebuf_next(
 	PandaLineBuf linebuf);
+/**
+ * Read the next line without needing it to be terminated.
+ *
+ * For uncompressed files, the line is not copied out of the file.
+ * @length: (out): the number of characters in the line, not including the end of line
+ * Returns: (transfer none) (allow-none) (array length=length): the next line in the file. This is only valid until the next call and may not be followed by a null character.
+ */
+const char *panda_linebuf_next_length(
+	PandaLineBuf linebuf,
+	size_t *length);
 EXTERN_C_END
 #endif
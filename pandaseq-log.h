@@ -106,6 +106,15 @@ void panda_log_proxy_write_overlap(
 	PandaLogProxy proxy,
 	PandaAssembler assembler);
 
+/**
+ * Print the histograms of the offsets at which an assembler found its primers to the log.
+ *
+ * This method is thread-safe.
+ */
+void panda_log_proxy_write_primer_offsets(
+	PandaLogProxy proxy,
+	PandaAssembler assembler);
+
 /**
  * Put a printf-like message in the log.
  */
@@ -120,6 +120,17 @@ const char *panda_module_get_name(
 const char *panda_module_get_usage(
 	PandaModule module);
 
+/**
+ * Whether the module's check reads the log probabilities of the bases in the assembled sequence.
+ *
+ * If not, an assembler producing compact results does not need to fill them in for this module. This must be set before the module is added to an assembler. The default is true.
+ */
+bool panda_module_get_uses_sequence(
+	PandaModule module);
+void panda_module_set_uses_sequence(
+	PandaModule module,
+	bool uses_sequence);
+
 /**
  * Get the version of a module.
  *
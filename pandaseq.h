@@ -77,6 +77,29 @@ size_t panda_compute_offset_qual(
 	const panda_nt *needle,
 	size_t needle_length);
 
+/**
+ * Find the offset of a small sequence in a large sequence, trying the most likely offsets first.
+ * @threshold: the minimum log probability to match
+ * @penalty: the penalty to subtract from the probability for each base from the start of the sequence
+ * @reverse: if false, scan the sequence from start to finish, else, scan in the opposite direction
+ * @haystack: (array length=haystack_length): the sequence to be searched
+ * @needle: (array length=needle_length): the sequence for which to look
+ * @expected: (array length=expected_length) (allow-none): offsets, as would be returned, to check first
+ *
+ * The first expected offset where the primer bases match with a mean probability, less the penalty, better than the threshold is accepted, even if a better one exists. Otherwise, this is the same as panda_compute_offset_qual.
+ * Returns: 0 if the sequence is not found, or one more than the offset
+ */
+size_t panda_compute_offset_qual_expected(
+	double threshold,
+	double penalty,
+	bool reverse,
+	const panda_qual *haystack,
+	size_t haystack_length,
+	const panda_nt *needle,
+	size_t needle_length,
+	const size_t *expected,
+	size_t expected_length);
+
 /**
  * Find the best offset of a small sequence in a large sequence.
  * @threshold: the minimum log probability to match
@@ -95,6 +118,29 @@ size_t panda_compute_offset_result(
 	const panda_nt *needle,
 	size_t needle_length);
 
+/**
+ * Find the offset of a small sequence in a large sequence, trying the most likely offsets first.
+ * @threshold: the minimum log probability to match
+ * @penalty: the penalty to subtract from the probability for each base from the start of the sequence
+ * @reverse: if false, scan the sequence from start to finish, else, scan in the opposite direction
+ * @haystack: (array length=haystack_length): the sequence to be searched
+ * @needle: (array length=needle_length): the sequence for which to look
+ * @expected: (array length=expected_length) (allow-none): offsets, as would be returned, to check first
+ *
+ * The first expected offset where the primer bases match with a mean probability, less the penalty, better than the threshold is accepted, even if a better one exists. Otherwise, this is the same as panda_compute_offset_result.
+ * Returns: 0 if the sequence is not found, or one more than the offset
+ */
+size_t panda_compute_offset_result_expected(
+	double threshold,
+	double penalty,
+	bool reverse,
+	const panda_result *haystack,
+	size_t haystack_length,
+	const panda_nt *needle,
+	size_t needle_length,
+	const size_t *expected,
+	size_t expected_length);
+
 /**
  * Create an object to read sequences from two character streams of FASTQ data
  *
@@ -231,7 +277,8 @@ char panda_result_phred(
 /**
  * Open a file that might be uncompressed or compressed with gzip or bzip2.
  *
- * @file_name: the file to open
+ * The file is never rewound, so it may be a pipe or FIFO.
+ * @file_name: the file to open, or - for standard input
  * @logger: the logger to write data
  * Returns: (scope notified) (closure user_data): the buffer read function to use.
  */
@@ -331,6 +378,7 @@ PandaNextSeq panda_create_async_reader(
 #        include<pandaseq-algorithm.h>
 #        include<pandaseq-args.h>
 #        include<pandaseq-assembler.h>
+#        include<pandaseq-demux.h>
 #        include<pandaseq-iter.h>
 #        include<pandaseq-linebuf.h>
 #        include<pandaseq-log.h>
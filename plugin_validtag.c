@@ -2,16 +2,81 @@
 #include<string.h>
 #include<pandaseq-plugin.h>
 
-HELP("Filter out any sequences without a valid index tag.", "validtag:TAG1:TAG2:TAG3");
-VER_INFO("1.0");
+HELP("Filter out any sequences without a valid index tag. If correct is given, tags with a single error are fixed, unless they are close to more than one valid tag.", "validtag[:correct]:TAG1:TAG2:TAG3");
+VER_INFO("1.1");
+
+/* A tag, or a tag with one error, that can appear in a sequence. */
+struct entry {
+	const char *key;
+	/* The valid tag this is, or should be corrected to, or NULL if it is equally close to several. */
+	const char *tag;
+	int distance;
+};
 
 struct data {
 	char **tags;
 	char *tag_data;
 	int numtags;
 	int taglen;
+	bool correct;
+	struct entry *entries;
+	char *entry_keys;
+	size_t numentries;
+	/* An open-addressed hash table of entry indices, plus one, so that zero is an empty slot. */
+	size_t *table;
+	size_t table_size;
 };
 
+static size_t hash_key(
+	const char *key,
+	int length) {
+	size_t hash = 2166136261u;
+	int it;
+	for (it = 0; it < length; it++) {
+		hash = (hash ^ (unsigned char) key[it]) * 16777619u;
+	}
+	return hash;
+}
+
+/* Find the slot holding a key or the empty slot where it should go. */
+static size_t *find_slot(
+	const struct data *data,
+	const char *key) {
+	size_t slot = hash_key(key, data->taglen) & (data->table_size - 1);
+	while (data->table[slot] != 0 && strncmp(data->entries[data->table[slot] - 1].key, key, data->taglen) != 0) {
+		slot = (slot + 1) & (data->table_size - 1);
+	}
+	return &data->table[slot];
+}
+
+static void add_entry(
+	PandaLogProxy logger,
+	struct data *data,
+	const char *key,
+	const char *tag,
+	int distance) {
+	size_t *slot = find_slot(data, key);
+	struct entry *entry;
+	if (*slot == 0) {
+		char *entry_key = data->entry_keys + data->numentries * data->taglen;
+		memcpy(entry_key, key, data->taglen);
+		entry = &data->entries[data->numentries];
+		entry->key = entry_key;
+		entry->tag = tag;
+		entry->distance = distance;
+		*slot = ++data->numentries;
+		return;
+	}
+	entry = &data->entries[*slot - 1];
+	if (distance < entry->distance) {
+		entry->tag = tag;
+		entry->distance = distance;
+	} else if (distance == entry->distance && entry->tag != NULL && strncmp(entry->tag, tag, data->taglen) != 0) {
+		panda_log_proxy_write_f(logger, "INFO\tVALTAG\tAMBIGUOUS\t%.*s\t%.*s\t%.*s\n", data->taglen, key, data->taglen, entry->tag, data->taglen, tag);
+		entry->tag = NULL;
+	}
+}
+
 static bool precheck_func(
 	PandaLogProxy logger,
 	const panda_seq_identifier *id,
@@ -21,46 +86,61 @@ static bool precheck_func(
 	size_t reverse_length,
 	void *user_data) {
 	struct data *data = (struct data *) user_data;
-
-	int it;
+	size_t index;
 	const char *tag = id->tag;
 	(void) logger;
 	(void) forward;
 	(void) forward_length;
 	(void) reverse;
 	(void) reverse_length;
-	if (tag == NULL)
+	if (tag == NULL || memchr(tag, '\0', data->taglen) != NULL)
 		return false;
 
-	for (it = 0; it < data->numtags; it++) {
-		if (strncmp(tag, data->tags[it], data->taglen) == 0) {
-			return true;
-		}
+	index = *find_slot(data, tag);
+	if (index == 0 || data->entries[index - 1].tag == NULL) {
+		return false;
 	}
-	return false;
+	if (data->entries[index - 1].distance > 0) {
+		/* Prechecks may correct the tag in place, so the output and any later modules see the valid tag. */
+		memcpy(((panda_seq_identifier *) id)->tag, data->entries[index - 1].tag, data->taglen);
+	}
+	return true;
 }
 
 static void destroy_func(
 	struct data *data) {
 	free(data->tags);
 	free(data->tag_data);
+	free(data->entries);
+	free(data->entry_keys);
+	free(data->table);
 	free(data);
 }
 
 OPEN {
+	static const char substitutions[] = "ACGTN";
 	struct data data;
 	const char *it = args;
 	char *wit;
 	char **currtag;
+	int tag;
+	int position;
+	size_t substitution;
 
 	(void) check;
 	data.numtags = 1;
 	data.taglen = 0;
+	data.correct = false;
 
 	if (args == NULL) {
 		panda_log_proxy_write_f(logger, "ERR\tVALTAG\tNOTAGS\n");
 		return false;
 	}
+	if (strncmp(args, "correct:", 8) == 0) {
+		data.correct = true;
+		args += 8;
+		it = args;
+	}
 	while (*it != '\0' && *it != ':') {
 		data.taglen++;
 		it++;
@@ -102,6 +182,35 @@ OPEN {
 		wit++;
 	}
 
+	/* Every tag, plus every way of changing one base in it, if correcting. */
+	data.numentries = 0;
+	data.table_size = 16;
+	while (data.table_size < 2 * (size_t) data.numtags * (data.correct ? (sizeof(substitutions) - 1) * data.taglen + 1 : 1)) {
+		data.table_size *= 2;
+	}
+	data.entries = malloc(sizeof(struct entry) * data.table_size / 2);
+	data.entry_keys = malloc(data.taglen * data.table_size / 2);
+	data.table = calloc(data.table_size, sizeof(size_t));
+	for (tag = 0; tag < data.numtags; tag++) {
+		add_entry(logger, &data, data.tags[tag], data.tags[tag], 0);
+	}
+	if (data.correct) {
+		char *key = malloc(data.taglen);
+		for (tag = 0; tag < data.numtags; tag++) {
+			memcpy(key, data.tags[tag], data.taglen);
+			for (position = 0; position < data.taglen; position++) {
+				for (substitution = 0; substitution < sizeof(substitutions) - 1; substitution++) {
+					if (substitutions[substitution] != data.tags[tag][position]) {
+						key[position] = substitutions[substitution];
+						add_entry(logger, &data, key, data.tags[tag], 1);
+					}
+				}
+				key[position] = data.tags[tag][position];
+			}
+		}
+		free(key);
+	}
+
 	*precheck = precheck_func;
 	*user_data = PANDA_STRUCT_DUP(&data);
 	*destroy = (PandaDestroy) destroy_func;
@@ -68,9 +68,12 @@ static void printtime(
 		count);
 }
 
+static const char *const seed_stat_names[] = { "SEEDKMER", "SEEDSPACED", "SEEDSHORT", "SEEDALL" };
+
 static void *do_assembly(
 	struct thread_info *info) {
 	long count;
+	PandaSeed seed;
 	const panda_result_seq *result;
 
 	while ((result = panda_assembler_next(info->assembler)) != NULL) {
@@ -83,10 +86,10 @@ static void *do_assembly(
 	count = panda_assembler_get_count(info->assembler);
 	info->some_seqs = count > 0;
 	printtime(info, count);
-	if (panda_assembler_get_forward_primer(info->assembler, NULL) != NULL)
+	if (panda_assembler_get_forward_primer(info->assembler, NULL) != NULL || panda_assembler_get_forward_primers(info->assembler, NULL) != NULL)
 		STAT("NOFP", long,
 			panda_assembler_get_no_forward_primer_count(info->assembler));
-	if (panda_assembler_get_reverse_primer(info->assembler, NULL) != NULL)
+	if (panda_assembler_get_reverse_primer(info->assembler, NULL) != NULL || panda_assembler_get_reverse_primers(info->assembler, NULL) != NULL)
 		STAT("NORP", long,
 			panda_assembler_get_no_reverse_primer_count(info->assembler));
 	STAT("NOALGN", long,
@@ -97,11 +100,23 @@ static void *do_assembly(
 		panda_assembler_get_bad_read_count(info->assembler));
 	STAT("SLOW", long,
 		panda_assembler_get_slow_count(info->assembler));
+	STAT("KMERLEN", size_t,
+		panda_assembler_get_kmer_length(info->assembler));
+	for (seed = PANDA_SEED_KMER; seed <= PANDA_SEED_ALL; seed++) {
+		if (panda_assembler_get_seed_policy(info->assembler) & PANDA_SEED_POLICY(seed)) {
+			STAT(seed_stat_names[seed], long,
+				panda_assembler_get_seed_count(info->assembler, seed));
+		}
+	}
+	if (panda_assembler_get_overlap_warmup(info->assembler) > 0)
+		STAT("PRIOR", long,
+			panda_assembler_get_prior_count(info->assembler));
 	panda_assembler_module_stats(info->assembler);
 	STAT("OK", long,
 		panda_assembler_get_ok_count(info->assembler));
 
 	panda_log_proxy_write_overlap(info->assembler->logger, info->assembler);
+	panda_log_proxy_write_primer_offsets(info->assembler->logger, info->assembler);
 
 	panda_assembler_unref(info->assembler);
 	return NULL;
@@ -189,6 +189,29 @@ void panda_log_proxy_write_overlap(
 	panda_writer_commit(proxy->writer);
 }
 
+void panda_log_proxy_write_primer_offsets(
+	PandaLogProxy proxy,
+	PandaAssembler assembler) {
+	static const char *const names[] = { "FPOFFSETS", "RPOFFSETS" };
+	size_t primer;
+	size_t it;
+	size_t max;
+
+	for (primer = 0; primer < 2; primer++) {
+		if (primer == 0 ? (panda_assembler_get_forward_primer(assembler, NULL) == NULL && panda_assembler_get_forward_primers(assembler, NULL) == NULL) : (panda_assembler_get_reverse_primer(assembler, NULL) == NULL && panda_assembler_get_reverse_primers(assembler, NULL) == NULL)) {
+			continue;
+		}
+		write_assembler_name(proxy, assembler);
+		panda_writer_append(proxy->writer, "STAT\t%s\t%ld", names[primer], panda_assembler_get_primer_offset_count(assembler, primer, 0));
+		max = panda_assembler_get_longest_primer_offset(assembler, primer);
+		for (it = 1; it <= max; it++) {
+			panda_writer_append(proxy->writer, " %ld", panda_assembler_get_primer_offset_count(assembler, primer, it));
+		}
+		panda_writer_append_c(proxy->writer, '\n');
+		panda_writer_commit(proxy->writer);
+	}
+}
+
 void panda_log_proxy_stat_double(
 	PandaLogProxy proxy,
 	PandaAssembler assembler,
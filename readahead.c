@@ -0,0 +1,330 @@
+/* PANDAseq -- Assemble paired FASTQ Illumina reads and strip the region between amplification primers.
+     Copyright (C) 2011-2013  Andre Masella
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+#include "config.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "pandaseq.h"
+#include "misc.h"
+#include "readahead.h"
+
+/* BGZF blocks are at most 64 KiB, both compressed and decompressed, so a chunk, or a thread's block buffer, always holds one. */
+#define CHUNK_SIZE (64 * 1024)
+#define CHUNKS_PER_THREAD 4
+#define MAX_BGZF_THREADS 8
+#define GZIP_HEADER_LENGTH 12
+#define GZIP_TRAILER_LENGTH 8
+
+struct chunk {
+	char data[CHUNK_SIZE];
+	size_t length;
+	bool ready;
+	bool ok;
+	bool eof;
+};
+
+/* Chunks are numbered in the order they appear in the file and are filled in a ring, so the reader always takes them in order, however they were filled. */
+struct read_ahead {
+	MANAGED_MEMBER(
+		PandaBufferRead,
+		source);
+	bool bgzf;
+	/* Held while claiming a chunk and reading its data from the source, so the source is read in order by one thread at a time. It is taken before the mutex. */
+	pthread_mutex_t read_mutex;
+	/* Held while changing the state of the ring. */
+	pthread_mutex_t mutex;
+	pthread_cond_t is_ready;
+	pthread_cond_t has_free;
+	bool done;
+	/* The chunk being read and how much of it has been read. */
+	size_t current;
+	size_t offset;
+	/* The next chunk to be filled and the one after the end of the file. */
+	size_t next;
+	size_t end;
+	struct chunk *chunks;
+	size_t num_chunks;
+	pthread_t *threads;
+	size_t num_threads;
+};
+
+bool bgzf_check_header(
+	const char *header,
+	size_t header_length) {
+	const unsigned char *bytes = (const unsigned char *) header;
+	return header_length >= GZIP_HEADER_LENGTH + 6 && bytes[0] == 0x1F && bytes[1] == 0x8B && bytes[2] == 8 && (bytes[3] & 4) != 0 && (bytes[10] | bytes[11] << 8) >= 6 && bytes[12] == 'B' && bytes[13] == 'C' && bytes[14] == 2 && bytes[15] == 0;
+}
+
+static bool read_fully(
+	struct read_ahead *data,
+	unsigned char *buffer,
+	size_t length,
+	size_t *read) {
+	*read = 0;
+	while (*read < length) {
+		size_t new_bytes;
+		if (!data->source((char *) buffer + *read, length - *read, &new_bytes, data->source_data)) {
+			return false;
+		}
+		if (new_bytes == 0) {
+			return true;
+		}
+		*read += new_bytes;
+	}
+	return true;
+}
+
+/* Read the next whole block into the thread's buffer. Blocks must be read in order, so this is done holding the read lock. */
+static bool read_block(
+	struct read_ahead *data,
+	struct chunk *chunk,
+	unsigned char *block,
+	size_t *block_length_out) {
+	size_t length;
+	size_t extra_length;
+	size_t block_length = 0;
+	size_t it;
+	if (!read_fully(data, block, GZIP_HEADER_LENGTH, &length)) {
+		return false;
+	}
+	if (length == 0) {
+		chunk->eof = true;
+		return true;
+	}
+	if (length < GZIP_HEADER_LENGTH || block[0] != 0x1F || block[1] != 0x8B || (block[3] & 4) == 0) {
+		return false;
+	}
+	extra_length = block[10] | block[11] << 8;
+	if (GZIP_HEADER_LENGTH + extra_length > CHUNK_SIZE || !read_fully(data, block + GZIP_HEADER_LENGTH, extra_length, &length) || length < extra_length) {
+		return false;
+	}
+	for (it = GZIP_HEADER_LENGTH; it + 4 <= GZIP_HEADER_LENGTH + extra_length; it += 4 + (block[it + 2] | block[it + 3] << 8)) {
+		if (block[it] == 'B' && block[it + 1] == 'C' && (block[it + 2] | block[it + 3] << 8) == 2 && it + 6 <= GZIP_HEADER_LENGTH + extra_length) {
+			block_length = (block[it + 4] | block[it + 5] << 8) + 1;
+		}
+	}
+	if (block_length < GZIP_HEADER_LENGTH + extra_length + GZIP_TRAILER_LENGTH || block_length > CHUNK_SIZE) {
+		return false;
+	}
+	if (!read_fully(data, block + GZIP_HEADER_LENGTH + extra_length, block_length - GZIP_HEADER_LENGTH - extra_length, &length) || length < block_length - GZIP_HEADER_LENGTH - extra_length) {
+		return false;
+	}
+	*block_length_out = block_length;
+	return true;
+}
+
+/* Each block is a complete gzip member, so zlib checks its CRC and length. */
+static bool inflate_block(
+	z_stream *strm,
+	unsigned char *block,
+	size_t block_length,
+	struct chunk *chunk) {
+	inflateReset(strm);
+	strm->next_in = block;
+	strm->avail_in = block_length;
+	strm->next_out = (Bytef *) chunk->data;
+	strm->avail_out = CHUNK_SIZE;
+	if (inflate(strm, Z_FINISH) != Z_STREAM_END) {
+		return false;
+	}
+	chunk->length = CHUNK_SIZE - strm->avail_out;
+	return true;
+}
+
+static void *read_ahead_thread(
+	struct read_ahead *data) {
+	z_stream strm;
+	unsigned char *block = NULL;
+	size_t block_length = 0;
+	bool inflating = false;
+	if (data->bgzf) {
+		strm.zalloc = Z_NULL;
+		strm.zfree = Z_NULL;
+		strm.opaque = Z_NULL;
+		strm.next_in = Z_NULL;
+		strm.avail_in = 0;
+		inflating = inflateInit2(&strm, 15 + 16) == Z_OK;
+		block = malloc(CHUNK_SIZE);
+	}
+	while (true) {
+		struct chunk *chunk;
+		size_t index;
+		pthread_mutex_lock(&data->read_mutex);
+		pthread_mutex_lock(&data->mutex);
+		while (!data->done && data->next < data->end && data->next >= data->current + data->num_chunks) {
+			pthread_cond_wait(&data->has_free, &data->mutex);
+		}
+		if (data->done || data->next >= data->end) {
+			pthread_mutex_unlock(&data->mutex);
+			pthread_mutex_unlock(&data->read_mutex);
+			break;
+		}
+		index = data->next++;
+		pthread_mutex_unlock(&data->mutex);
+
+		/* The chunk is not touched by the reader until it is ready. */
+		chunk = &data->chunks[index % data->num_chunks];
+		chunk->length = 0;
+		chunk->eof = false;
+		if (data->bgzf) {
+			chunk->ok = inflating && block != NULL && read_block(data, chunk, block, &block_length);
+		} else {
+			chunk->ok = data->source(chunk->data, CHUNK_SIZE, &chunk->length, data->source_data);
+			chunk->eof = chunk->length == 0;
+		}
+		if (!chunk->ok || chunk->eof) {
+			/* No chunk after this one may be claimed, so this must be done before letting the next thread read. */
+			pthread_mutex_lock(&data->mutex);
+			data->end = index + 1;
+			pthread_mutex_unlock(&data->mutex);
+		}
+		pthread_mutex_unlock(&data->read_mutex);
+
+		if (data->bgzf && chunk->ok && !chunk->eof) {
+			chunk->ok = inflate_block(&strm, block, block_length, chunk);
+		}
+		pthread_mutex_lock(&data->mutex);
+		chunk->ready = true;
+		pthread_cond_broadcast(&data->is_ready);
+		pthread_mutex_unlock(&data->mutex);
+	}
+	free(block);
+	if (inflating) {
+		inflateEnd(&strm);
+	}
+	return NULL;
+}
+
+static bool read_ahead_read(
+	char *buffer,
+	size_t buffer_length,
+	size_t *read,
+	struct read_ahead *data) {
+	struct chunk *chunk;
+	*read = 0;
+	pthread_mutex_lock(&data->mutex);
+	while (true) {
+		chunk = &data->chunks[data->current % data->num_chunks];
+		while (!chunk->ready) {
+			pthread_cond_wait(&data->is_ready, &data->mutex);
+		}
+		if (!chunk->ok || chunk->eof || data->offset < chunk->length) {
+			break;
+		}
+		/* This chunk is used up, so it can be filled again. Empty BGZF blocks are skipped this way too. */
+		chunk->ready = false;
+		data->current++;
+		data->offset = 0;
+		pthread_cond_broadcast(&data->has_free);
+	}
+	pthread_mutex_unlock(&data->mutex);
+	if (!chunk->ok) {
+		return false;
+	}
+	if (chunk->eof) {
+		return true;
+	}
+	/* The chunk is not touched by the other threads until it has been used up. */
+	*read = chunk->length - data->offset < buffer_length ? chunk->length - data->offset : buffer_length;
+	memcpy(buffer, chunk->data + data->offset, *read);
+	data->offset += *read;
+	return true;
+}
+
+static void read_ahead_destroy(
+	struct read_ahead *data) {
+	size_t it;
+	pthread_mutex_lock(&data->mutex);
+	data->done = true;
+	pthread_cond_broadcast(&data->has_free);
+	pthread_mutex_unlock(&data->mutex);
+	for (it = 0; it < data->num_threads; it++) {
+		pthread_join(data->threads[it], NULL);
+	}
+	pthread_cond_destroy(&data->is_ready);
+	pthread_cond_destroy(&data->has_free);
+	pthread_mutex_destroy(&data->mutex);
+	pthread_mutex_destroy(&data->read_mutex);
+	DESTROY_MEMBER(data, source);
+	free(data->threads);
+	free(data->chunks);
+	free(data);
+}
+
+static PandaBufferRead read_ahead_new(
+	PandaBufferRead source,
+	void *source_data,
+	PandaDestroy source_destroy,
+	bool bgzf,
+	size_t num_threads,
+	void **user_data,
+	PandaDestroy *destroy) {
+	struct read_ahead *data = malloc(sizeof(struct read_ahead));
+	size_t it;
+	data->source = source;
+	data->source_data = source_data;
+	data->source_destroy = source_destroy;
+	data->bgzf = bgzf;
+	data->done = false;
+	data->current = 0;
+	data->offset = 0;
+	data->next = 0;
+	data->end = (size_t) -1;
+	data->num_chunks = CHUNKS_PER_THREAD * num_threads;
+	data->chunks = calloc(data->num_chunks, sizeof(struct chunk));
+	data->threads = calloc(num_threads, sizeof(pthread_t));
+	data->num_threads = 0;
+	pthread_mutex_init(&data->read_mutex, NULL);
+	pthread_mutex_init(&data->mutex, NULL);
+	pthread_cond_init(&data->is_ready, NULL);
+	pthread_cond_init(&data->has_free, NULL);
+	for (it = 0; it < num_threads; it++) {
+		if (pthread_create(&data->threads[data->num_threads], NULL, (void *(*)(void *)) &read_ahead_thread, data) == 0) {
+			data->num_threads++;
+		}
+	}
+	if (data->num_threads == 0) {
+		/* The caller still owns the source. */
+		data->source_destroy = NULL;
+		read_ahead_destroy(data);
+		return NULL;
+	}
+	*user_data = data;
+	*destroy = (PandaDestroy) read_ahead_destroy;
+	return (PandaBufferRead) read_ahead_read;
+}
+
+PandaBufferRead bgzf_open(
+	PandaBufferRead source,
+	void *source_data,
+	PandaDestroy source_destroy,
+	void **user_data,
+	PandaDestroy *destroy) {
+	int num_threads = panda_get_default_worker_threads();
+	return read_ahead_new(source, source_data, source_destroy, true, num_threads > MAX_BGZF_THREADS ? MAX_BGZF_THREADS : num_threads, user_data, destroy);
+}
+
+PandaBufferRead read_ahead_open(
+	PandaBufferRead source,
+	void *source_data,
+	PandaDestroy source_destroy,
+	void **user_data,
+	PandaDestroy *destroy) {
+	return read_ahead_new(source, source_data, source_destroy, false, 1, user_data, destroy);
+}
@@ -0,0 +1,45 @@
+/* PANDAseq -- Assemble paired FASTQ Illumina reads and strip the region between amplification primers.
+     Copyright (C) 2011-2013  Andre Masella
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+#ifndef READAHEAD_H
+#        define READAHEAD_H
+#        include <stdbool.h>
+#        include <stddef.h>
+#        include "config.h"
+#        include "pandaseq.h"
+
+/* Check if the start of a file is the header of a BGZF block: a gzip member with a BC extra field giving its compressed size. */
+bool bgzf_check_header(
+	const char *header,
+	size_t header_length);
+
+/* Decompress a BGZF file, reading the blocks in order, but decompressing them on several threads. Returns NULL, without destroying the source, if no threads could be started. */
+PandaBufferRead bgzf_open(
+	PandaBufferRead source,
+	void *source_data,
+	PandaDestroy source_destroy,
+	void **user_data,
+	PandaDestroy *destroy);
+
+/* Read from the source on another thread, so that it runs ahead of the reader. Returns NULL, without destroying the source, if the thread could not be started. */
+PandaBufferRead read_ahead_open(
+	PandaBufferRead source,
+	void *source_data,
+	PandaDestroy source_destroy,
+	void **user_data,
+	PandaDestroy *destroy);
+#endif